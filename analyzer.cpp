@@ -0,0 +1,304 @@
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "analyzer.hpp"
+
+namespace chip8 {
+static char const* edgeName(Analyzer::EdgeKind aKind) {
+    switch (aKind) {
+        case Analyzer::EDGE_FALLTHROUGH: return "fallthrough";
+        case Analyzer::EDGE_JUMP: return "jump";
+        case Analyzer::EDGE_CALL: return "call";
+        case Analyzer::EDGE_RETURN: return "return";
+        case Analyzer::EDGE_SKIP: return "skip";
+    }
+
+    return "";
+}
+
+static std::string hex(uint16_t aValue, int aWidth = 3) {
+    std::ostringstream out;
+    out << "0x" << std::uppercase << std::hex << std::setw(aWidth)
+        << std::setfill('0') << aValue;
+    return out.str();
+}
+
+Analyzer::Analyzer(std::string aROMName) {
+    loadROM(aROMName);
+}
+
+void Analyzer::loadROM(std::string aROMName) {
+    std::ifstream rom(aROMName, std::ios::binary | std::ios::ate);
+
+    if (!rom.is_open()) {
+        error("Failed to open ROM file");
+    }
+
+    std::streampos size = rom.tellg();
+
+    if (size > MEM_HI - MEM_LO) {
+        error("ROM file exceeds usable memory");
+    }
+
+    rom.seekg(0, std::ios::beg);
+    rom.read((char*)(memory + MEM_LO), size);
+    romEnd = MEM_LO + size;
+}
+
+void Analyzer::error(std::string aMessage) const {
+    std::cerr << aMessage << std::endl;
+    exit(1);
+}
+
+uint16_t Analyzer::fetch(uint16_t aAddress) const {
+    return (memory[aAddress] << 8u) | memory[aAddress + 1];
+}
+
+bool Analyzer::inImage(uint16_t aAddress) const {
+    return aAddress >= MEM_LO && aAddress + 1 < romEnd;
+}
+
+void Analyzer::analyze(uint16_t aEntry) {
+    std::vector<uint16_t> work{aEntry};
+    leader[aEntry] = true;
+
+    // Recursive traversal: follow every statically known successor
+    while (!work.empty()) {
+        uint16_t pc = work.back();
+        work.pop_back();
+
+        if (!inImage(pc) || inst[pc]) {
+            continue;
+        }
+
+        inst[pc] = true;
+        code[pc] = code[pc + 1] = true;
+
+        uint16_t opcode = fetch(pc);
+        uint16_t target = opcode & 0x0FFFu;
+
+        switch (opInfo[decode(opcode)].flow) {
+            case FLOW_NEXT:
+                work.push_back(pc + 2);
+                break;
+            case FLOW_JUMP:
+                leader[target] = true;
+                work.push_back(target);
+                break;
+            case FLOW_CALL:
+                leader[target] = leader[pc + 2] = true;
+                work.push_back(target);
+                work.push_back(pc + 2);
+                break;
+            case FLOW_SKIP:
+                leader[pc + 2] = leader[pc + 4] = true;
+                work.push_back(pc + 2);
+                work.push_back(pc + 4);
+                break;
+            case FLOW_RET:
+            case FLOW_COMPUTED:
+            case FLOW_INVALID:
+                break;
+        }
+    }
+
+    // Form basic blocks from the discovered instructions
+    cfg.clear();
+
+    // Every reachable instruction is either a leader or follows an instruction
+    // that falls through, so blocks simply run from one leader to the next
+    for (uint32_t start = MEM_LO; start < romEnd; ++start) {
+        if (!inst[start] || !leader[start]) {
+            continue;
+        }
+
+        Block block{uint16_t(start), uint16_t(start), {}, false, false};
+        uint16_t pc = start;
+
+        while (true) {
+            uint16_t opcode = fetch(pc);
+            Op op = decode(opcode);
+            uint16_t target = opcode & 0x0FFFu;
+            uint16_t next = pc + 2;
+
+            block.end = next;
+
+            switch (opInfo[op].flow) {
+                case FLOW_NEXT:
+                    if (inst[next] && !leader[next]) {
+                        pc = next;
+                        continue;
+                    }
+
+                    if (inst[next]) {
+                        block.successors.push_back({next, EDGE_FALLTHROUGH});
+                    } else {
+                        block.invalid = true;
+                    }
+                    break;
+                case FLOW_JUMP:
+                    block.successors.push_back({target, EDGE_JUMP});
+                    break;
+                case FLOW_CALL:
+                    block.successors.push_back({target, EDGE_CALL});
+                    block.successors.push_back({next, EDGE_RETURN});
+                    break;
+                case FLOW_SKIP:
+                    block.successors.push_back({next, EDGE_FALLTHROUGH});
+                    block.successors.push_back({uint16_t(pc + 4), EDGE_SKIP});
+                    break;
+                case FLOW_COMPUTED:
+                    block.computed = true;
+                    break;
+                case FLOW_RET:
+                    break;
+                case FLOW_INVALID:
+                    block.invalid = true;
+                    break;
+            }
+
+            break;
+        }
+
+        cfg[block.start] = block;
+    }
+}
+
+std::vector<std::pair<uint16_t, uint16_t>> Analyzer::dataRanges() const {
+    std::vector<std::pair<uint16_t, uint16_t>> ranges;
+
+    for (uint16_t i = MEM_LO; i < romEnd; ++i) {
+        if (code[i]) {
+            continue;
+        }
+
+        uint16_t start = i;
+
+        while (i < romEnd && !code[i]) {
+            ++i;
+        }
+
+        ranges.emplace_back(start, i);
+    }
+
+    return ranges;
+}
+
+void Analyzer::dumpText(std::ostream& aOut) const {
+    for (auto const& entry : cfg) {
+        Block const& block = entry.second;
+
+        aOut << "block " << hex(block.start);
+
+        if (!block.successors.empty()) {
+            aOut << " ->";
+
+            for (Edge const& edge : block.successors) {
+                aOut << " " << hex(edge.to) << " (" << edgeName(edge.kind) << ")";
+            }
+        }
+
+        if (block.computed) {
+            aOut << " [computed jump]";
+        }
+
+        if (block.invalid) {
+            aOut << " [invalid]";
+        }
+
+        aOut << "\n";
+
+        for (uint16_t pc = block.start; pc < block.end; pc += 2) {
+            aOut << "  " << hex(pc) << ": " << hex(fetch(pc), 4).substr(2) << "  "
+                 << disassemble(fetch(pc)) << "\n";
+        }
+    }
+
+    for (auto const& range : dataRanges()) {
+        aOut << "data " << hex(range.first) << "-" << hex(range.second - 1) << "\n";
+    }
+}
+
+void Analyzer::dumpDot(std::ostream& aOut) const {
+    aOut << "digraph rom {\n"
+         << "  node [shape=box, fontname=monospace];\n";
+
+    for (auto const& entry : cfg) {
+        Block const& block = entry.second;
+
+        aOut << "  b" << block.start << " [label=\"";
+
+        for (uint16_t pc = block.start; pc < block.end; pc += 2) {
+            aOut << hex(pc) << ": " << disassemble(fetch(pc)) << "\\l";
+        }
+
+        aOut << "\"";
+
+        if (block.computed || block.invalid) {
+            aOut << ", color=red";
+        }
+
+        aOut << "];\n";
+
+        for (Edge const& edge : block.successors) {
+            aOut << "  b" << block.start << " -> b" << edge.to;
+
+            if (edge.kind == EDGE_CALL) {
+                aOut << " [style=dashed]";
+            } else if (edge.kind == EDGE_SKIP) {
+                aOut << " [style=dotted]";
+            }
+
+            aOut << ";\n";
+        }
+    }
+
+    aOut << "}\n";
+}
+
+void Analyzer::dumpJson(std::ostream& aOut) const {
+    aOut << "{\n  \"entry\": " << MEM_LO << ",\n  \"blocks\": [";
+
+    bool first = true;
+
+    for (auto const& entry : cfg) {
+        Block const& block = entry.second;
+
+        aOut << (first ? "\n" : ",\n") << "    {\"start\": " << block.start
+             << ", \"end\": " << block.end
+             << ", \"computed\": " << (block.computed ? "true" : "false")
+             << ", \"invalid\": " << (block.invalid ? "true" : "false")
+             << ", \"instructions\": [";
+
+        for (uint16_t pc = block.start; pc < block.end; pc += 2) {
+            aOut << (pc == block.start ? "" : ", ") << "{\"addr\": " << pc
+                 << ", \"opcode\": " << fetch(pc) << ", \"text\": \""
+                 << disassemble(fetch(pc)) << "\"}";
+        }
+
+        aOut << "], \"successors\": [";
+
+        for (size_t i = 0; i < block.successors.size(); ++i) {
+            aOut << (i ? ", " : "") << "{\"to\": " << block.successors[i].to
+                 << ", \"kind\": \"" << edgeName(block.successors[i].kind) << "\"}";
+        }
+
+        aOut << "]}";
+        first = false;
+    }
+
+    aOut << "\n  ],\n  \"data\": [";
+
+    first = true;
+
+    for (auto const& range : dataRanges()) {
+        aOut << (first ? "" : ", ") << "{\"start\": " << range.first
+             << ", \"end\": " << range.second << "}";
+        first = false;
+    }
+
+    aOut << "]\n}\n";
+}
+} // chip8 namespace
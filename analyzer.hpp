@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "op.hpp"
+
+namespace chip8 {
+// Offline static analysis of a ROM. Code is found by recursive traversal from
+// MEM_LO using the shared decode tables in op.hpp, split into basic blocks and
+// linked into a control-flow graph. Bytes never reached are reported as data.
+class Analyzer final {
+    public:
+        enum EdgeKind : uint8_t {
+            EDGE_FALLTHROUGH,
+            EDGE_JUMP,
+            EDGE_CALL,
+            EDGE_RETURN,    // Instruction following a call
+            EDGE_SKIP
+        };
+
+        struct Edge {
+            uint16_t to;
+            EdgeKind kind;
+        };
+
+        struct Block {
+            uint16_t start;
+            // One past the last byte of the final instruction
+            uint16_t end;
+            std::vector<Edge> successors;
+            // Ends in Bnnn; the real target is only known at runtime
+            bool computed;
+            // Ends in an invalid opcode or runs off the loaded image
+            bool invalid;
+        };
+
+        Analyzer(std::string aROMName);
+
+        void analyze(uint16_t aEntry = MEM_LO);
+
+        std::map<uint16_t, Block> const& blocks() const { return cfg; }
+        bool isCode(uint16_t aAddress) const { return code[aAddress & MEM_HI]; }
+
+        // The analysed memory image; the ROM occupies [MEM_LO, romEnd)
+        uint8_t const* image() const { return memory; }
+        uint16_t imageEnd() const { return romEnd; }
+        uint16_t fetch(uint16_t aAddress) const;
+
+        void dumpText(std::ostream& aOut) const;
+        void dumpDot(std::ostream& aOut) const;
+        void dumpJson(std::ostream& aOut) const;
+
+    private:
+        void loadROM(std::string aROMName);
+        void error(std::string aMessage) const;
+        bool inImage(uint16_t aAddress) const;
+
+        // Ranges of bytes in the ROM image that were not reached as code
+        std::vector<std::pair<uint16_t, uint16_t>> dataRanges() const;
+
+        uint8_t memory[MAX_MEM]{};
+        uint16_t romEnd{MEM_LO};
+
+        // Byte is part of a reachable instruction. The maps are padded so that
+        // successors of the last instruction in memory can be marked safely
+        bool code[MAX_MEM + 4]{};
+        // An instruction starts here
+        bool inst[MAX_MEM + 4]{};
+        // A basic block starts here
+        bool leader[MAX_MEM + 4]{};
+
+        std::map<uint16_t, Block> cfg;
+};
+} // chip8 namespace
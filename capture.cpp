@@ -0,0 +1,286 @@
+#include <SDL2/SDL_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "capture.hpp"
+
+namespace chip8 {
+// LZW code table size limit
+#define GIF_MAX_CODES 4096
+
+static bool pixel(uint8_t const* aPixels, unsigned int aX, unsigned int aY) {
+    unsigned int bit = aY * GFX_WIDTH + aX;
+    return (aPixels[bit / 8] >> (7 - bit % 8)) & 1u;
+}
+
+// GIF delays are in hundredths of a second
+static uint64_t centiseconds(uint64_t aFrame) {
+    return aFrame * 100 / FRAME_RATE;
+}
+
+Capture::Capture(std::string aPath, CaptureFormat aFormat, unsigned int aScale)
+    : path(aPath)
+    , format(aFormat)
+    , scale(aScale ? aScale : 1) {
+    if (format != CAPTURE_PNG) {
+        out = fopen(path.c_str(), "wb");
+
+        if (!out) {
+            std::cerr << "Failed to open capture file " << path << std::endl;
+            return;
+        }
+
+        if (format == CAPTURE_GIF) {
+            writeGIFHeader();
+        }
+    }
+
+    thread = std::thread(&Capture::encode, this);
+}
+
+void Capture::close() {
+    shutdown = true;
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    if (out) {
+        if (format == CAPTURE_GIF) {
+            finishGIF();
+        }
+
+        fclose(out);
+        out = nullptr;
+    }
+}
+
+void Capture::encode() {
+    while (true) {
+        uint64_t tail = queueTail.load(std::memory_order_relaxed);
+
+        if (tail == queueHead.load(std::memory_order_acquire)) {
+            if (shutdown) {
+                return;
+            }
+
+            // Nothing to do; polling keeps the producer free of any wakeup cost
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            continue;
+        }
+
+        write(queue[tail % CAPTURE_QUEUE]);
+        queueTail.store(tail + 1, std::memory_order_release);
+    }
+}
+
+void Capture::write(Frame const& aFrame) {
+    switch (format) {
+        case CAPTURE_PNG:
+            writePNG(aFrame);
+            break;
+        case CAPTURE_RAW:
+            writeRaw(aFrame);
+            break;
+        case CAPTURE_GIF: {
+            if (!hasPending) {
+                pending = aFrame;
+                hasPending = true;
+                break;
+            }
+
+            uint16_t delay = centiseconds(aFrame.number) - centiseconds(pending.number);
+
+            // Viewers stretch delays under 2/100 s, so keep the newest image
+            // of such a burst and let it start where the burst started
+            if (delay < 2) {
+                memcpy(pending.pixels, aFrame.pixels, sizeof(pending.pixels));
+                break;
+            }
+
+            writeGIFFrame(pending, delay);
+            pending = aFrame;
+            break;
+        }
+    }
+}
+
+void Capture::writePNG(Frame const& aFrame) {
+    int width = GFX_WIDTH * scale;
+    int height = GFX_HEIGHT * scale;
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32,
+                                                          SDL_PIXELFORMAT_RGBA8888);
+
+    if (!surface) {
+        fail(SDL_GetError());
+        return;
+    }
+
+    for (int y = 0; y < height; ++y) {
+        uint32_t* row = (uint32_t*)((uint8_t*)surface->pixels + y * surface->pitch);
+
+        for (int x = 0; x < width; ++x) {
+            row[x] = pixel(aFrame.pixels, x / scale, y / scale) ? 0xFFFFFFFFu : 0x000000FFu;
+        }
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "/frame-%08llu.png", (unsigned long long)aFrame.number);
+
+    if (IMG_SavePNG(surface, (path + name).c_str()) == 0) {
+        ++writtenFrames;
+    } else {
+        fail((path + name + ": " + IMG_GetError()).c_str());
+    }
+
+    SDL_FreeSurface(surface);
+}
+
+void Capture::fail(char const* aReason) {
+    // A missing directory fails every frame the same way; say so once
+    if (failedFrames++ == 0) {
+        std::cerr << "Failed to write capture frame: " << aReason << std::endl;
+    }
+}
+
+void Capture::writeRaw(Frame const& aFrame) {
+    uint8_t number[8];
+
+    for (int i = 0; i < 8; ++i) {
+        number[i] = aFrame.number >> (8 * i);
+    }
+
+    fwrite(number, 1, sizeof(number), out);
+    fwrite(aFrame.pixels, 1, sizeof(aFrame.pixels), out);
+    ++writtenFrames;
+}
+
+void Capture::writeGIFHeader() {
+    uint16_t width = GFX_WIDTH * scale;
+    uint16_t height = GFX_HEIGHT * scale;
+
+    uint8_t const header[] = {
+        'G', 'I', 'F', '8', '9', 'a',
+        uint8_t(width), uint8_t(width >> 8), uint8_t(height), uint8_t(height >> 8),
+        // Global color table of 2 entries, background 0
+        0x80, 0, 0,
+        0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF,
+        // Loop forever
+        0x21, 0xFF, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0',
+        3, 1, 0, 0, 0
+    };
+
+    fwrite(header, 1, sizeof(header), out);
+}
+
+void Capture::writeGIFFrame(Frame const& aFrame, uint16_t aDelay) {
+    uint16_t width = GFX_WIDTH * scale;
+    uint16_t height = GFX_HEIGHT * scale;
+
+    uint8_t const descriptor[] = {
+        // Graphic control extension: delay, no transparency
+        0x21, 0xF9, 4, 0, uint8_t(aDelay), uint8_t(aDelay >> 8), 0, 0,
+        // Full frame image, no local color table
+        0x2C, 0, 0, 0, 0,
+        uint8_t(width), uint8_t(width >> 8), uint8_t(height), uint8_t(height >> 8), 0
+    };
+
+    fwrite(descriptor, 1, sizeof(descriptor), out);
+
+    indices.resize(width * height);
+
+    for (unsigned int y = 0; y < height; ++y) {
+        for (unsigned int x = 0; x < width; ++x) {
+            indices[y * width + x] = pixel(aFrame.pixels, x / scale, y / scale);
+        }
+    }
+
+    // LZW with the smallest code size GIF allows
+    unsigned int const minCodeSize = 2;
+    unsigned int const clearCode = 1u << minCodeSize;
+
+    // Code table as a trie: codes[code * 4 + index] extends code by one pixel
+    codes.assign(GIF_MAX_CODES << minCodeSize, 0);
+
+    std::vector<uint8_t> data;
+    uint32_t bits = 0;
+    unsigned int bitCount = 0;
+
+    auto emit = [&](unsigned int aCode, unsigned int aSize) {
+        bits |= aCode << bitCount;
+        bitCount += aSize;
+
+        while (bitCount >= 8) {
+            data.push_back(bits & 0xFF);
+            bits >>= 8;
+            bitCount -= 8;
+        }
+    };
+
+    unsigned int codeSize = minCodeSize + 1;
+    unsigned int maxCode = clearCode + 1;
+    unsigned int current = indices[0];
+
+    emit(clearCode, codeSize);
+
+    for (size_t i = 1; i < indices.size(); ++i) {
+        uint8_t value = indices[i];
+
+        if (codes[(current << minCodeSize) | value]) {
+            current = codes[(current << minCodeSize) | value];
+            continue;
+        }
+
+        emit(current, codeSize);
+        codes[(current << minCodeSize) | value] = ++maxCode;
+
+        if (maxCode >= (1u << codeSize)) {
+            ++codeSize;
+        }
+
+        if (maxCode == GIF_MAX_CODES - 1) {
+            emit(clearCode, codeSize);
+            std::fill(codes.begin(), codes.end(), 0);
+            codeSize = minCodeSize + 1;
+            maxCode = clearCode + 1;
+        }
+
+        current = value;
+    }
+
+    emit(current, codeSize);
+
+    // The decoder adds one more entry for the last code
+    if (maxCode + 1 >= (1u << codeSize) && codeSize < 12) {
+        ++codeSize;
+    }
+
+    emit(clearCode + 1, codeSize);
+
+    if (bitCount) {
+        data.push_back(bits & 0xFF);
+    }
+
+    fputc(minCodeSize, out);
+
+    for (size_t i = 0; i < data.size(); i += 255) {
+        size_t length = std::min<size_t>(255, data.size() - i);
+        fputc(length, out);
+        fwrite(data.data() + i, 1, length, out);
+    }
+
+    fputc(0, out);
+    ++writtenFrames;
+}
+
+void Capture::finishGIF() {
+    if (hasPending) {
+        writeGIFFrame(pending, 2);
+    }
+
+    fputc(0x3B, out);
+}
+} // chip8 namespace
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chip8.hpp"
+
+namespace chip8 {
+// Frames the emulation thread can get ahead of the encoder before it has to
+// drop or wait
+#define CAPTURE_QUEUE 64
+
+enum CaptureFormat {
+    // One PNG per changed frame, PATH/frame-NNNNNNNN.png
+    CAPTURE_PNG,
+    // A single looping animated GIF
+    CAPTURE_GIF,
+    // Records of a little endian 64-bit frame number followed by the screen
+    // at 1 bit per pixel, rows top to bottom, most significant bit leftmost
+    CAPTURE_RAW
+};
+
+// Records frames on a background thread. The emulation thread only packs the
+// screen into a slot of a single producer, single consumer ring. When the
+// encoder falls behind, a real-time caller has its push refused and offers
+// the then current screen again next frame, so only intermediate screens are
+// lost; a headless caller waits instead and loses nothing. The GIF encoder
+// additionally coalesces frames that are closer together than the format can
+// time.
+class Capture final {
+    public:
+        // aScale: pixel size for PNG and GIF output
+        Capture(std::string aPath, CaptureFormat aFormat, unsigned int aScale = 4);
+        ~Capture() { close(); }
+
+        // False if the output could not be opened. Nothing is encoded then
+        bool valid() const { return thread.joinable(); }
+
+        // Encode whatever is still queued and finish the output. Nothing may
+        // be pushed afterwards
+        void close();
+
+        // Emulation thread. aFrame is the emulated frame number, used for
+        // timing. Returns false if the queue is full, unless aWait is set, in
+        // which case it waits for the encoder to make room. Always false
+        // without an encoder
+        bool push(uint8_t const* aScreen, uint64_t aFrame, bool aWait) {
+            if (!valid()) {
+                return false;
+            }
+
+            uint64_t head = queueHead.load(std::memory_order_relaxed);
+
+            while (head - queueTail.load(std::memory_order_acquire) == CAPTURE_QUEUE) {
+                if (!aWait) {
+                    droppedFrames.store(droppedFrames.load(std::memory_order_relaxed) + 1,
+                                        std::memory_order_relaxed);
+                    return false;
+                }
+
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+
+            Frame& slot = queue[head % CAPTURE_QUEUE];
+            slot.number = aFrame;
+
+            packScreen(aScreen, slot.pixels);
+
+            queueHead.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        uint64_t dropped() const { return droppedFrames.load(std::memory_order_relaxed); }
+        uint64_t written() const { return writtenFrames.load(std::memory_order_relaxed); }
+        uint64_t failed() const { return failedFrames.load(std::memory_order_relaxed); }
+
+    private:
+        struct Frame {
+            uint64_t number;
+            uint8_t pixels[PACKED_SCREEN_SIZE];
+        };
+
+        void encode();
+        void write(Frame const& aFrame);
+
+        void writePNG(Frame const& aFrame);
+        void writeRaw(Frame const& aFrame);
+
+        // Count a frame that could not be written, reporting the first
+        void fail(char const* aReason);
+
+        // GIF frames are written one behind, once the next one gives their delay
+        void writeGIFHeader();
+        void writeGIFFrame(Frame const& aFrame, uint16_t aDelay);
+        void finishGIF();
+
+        std::string path;
+        CaptureFormat format;
+        unsigned int scale;
+        FILE* out{};
+
+        Frame queue[CAPTURE_QUEUE];
+        std::atomic<uint64_t> queueHead{0};
+        std::atomic<uint64_t> queueTail{0};
+        std::atomic<uint64_t> droppedFrames{0};
+        std::atomic<uint64_t> writtenFrames{0};
+        std::atomic<uint64_t> failedFrames{0};
+
+        // Encoder thread only
+        Frame pending{};
+        bool hasPending{};
+        std::vector<uint8_t> indices;
+        std::vector<uint16_t> codes;
+
+        std::atomic<bool> shutdown{false};
+        std::thread thread;
+};
+} // chip8 namespace
@@ -1,91 +1,131 @@
+#include <dlfcn.h>
+
 #include <chrono>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <thread>
 
+#include "capture.hpp"
 #include "chip8.hpp"
+#include "debugger.hpp"
+#include "frontend.hpp"
+#include "metrics.hpp"
 
 // Uncomment for instruction stream prints
 // #define DEBUG 1
 
 namespace chip8 {
+// ROM files expect fonts to be installed at specific locations in memory
+// Use the fonts array below at boot time to load font sprites
+static uint8_t const fonts[FONTS_SIZE] = {
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+};
+
+Chip8::Chip8Func Chip8::table[OP_TABLE_SIZE];
+Chip8::Chip8Func Chip8::table0[OP_TABLE0_SIZE];
+Chip8::Chip8Func Chip8::table8[OP_TABLE8_SIZE];
+Chip8::Chip8Func Chip8::tableE[OP_TABLEE_SIZE];
+Chip8::Chip8Func Chip8::tableF[OP_TABLEF_SIZE];
+
 Chip8::Chip8(std::string aROMName)
-    : pc(MEM_LO)
-    , randGen(std::chrono::system_clock::now().time_since_epoch().count())
-    , quit(false) {
+    : State() {
+    seed(std::chrono::system_clock::now().time_since_epoch().count());
+
+    // The dispatch tables are shared, the first machine fills them in
+    static bool const tablesLoaded = (loadInsts(), true);
+    (void)tablesLoaded;
+
     boot();
-    loadInsts();
     loadROM(aROMName);
 }
 
-Chip8::~Chip8() {
-    delete gfxHandle;
+// Fork: the tables are static and the state is plain data, so this is a copy
+// of a few kilobytes and no allocation
+Chip8::Chip8(Chip8 const& aOther)
+    : State(aOther)
+    , native(aOther.native)
+    , runAhead(aOther.runAhead)
+    , quit(aOther.quit.load()) {
 }
 
 void Chip8::boot() {
-    // Mostly sanity checks
-    std::cout << "Booting with " << MAX_MEM << " bytes of memory (usable = "
-              << MEM_HI - MEM_LO << " bytes)" << std::endl;
-
     // Load fonts into memory
     std::copy(std::begin(fonts), std::end(fonts), (std::begin(memory) + MEM_FNT));
 
-    // Initialize rand register
-    rand = std::uniform_int_distribution<uint8_t>(0, 255U);
 	delayTimer = 0;
 	sndTimer = 0;
 	sp = 0;
     pc = MEM_LO;
-
-    int videoScale = std::stoi("10");
-
-    gfxHandle = new Gfx("CHIP-8 Emulator", GFX_WIDTH * videoScale, GFX_HEIGHT * videoScale,
-                        GFX_WIDTH, GFX_HEIGHT);
 }
 
 void Chip8::loadInsts() {
-    table[0x0] = &Chip8::Table0;
-    table[0x1] = &Chip8::_1nnn;
-    table[0x2] = &Chip8::_2nnn;
-    table[0x3] = &Chip8::_3xkk;
-    table[0x4] = &Chip8::_4xkk;
-    table[0x5] = &Chip8::_5xy0;
-    table[0x6] = &Chip8::_6xkk;
-    table[0x7] = &Chip8::_7xkk;
-    table[0x8] = &Chip8::Table8;
-    table[0x9] = &Chip8::_9xy0;
-    table[0xA] = &Chip8::_annn;
-    table[0xB] = &Chip8::_bnnn;
-    table[0xC] = &Chip8::_cxkk;
-    table[0xD] = &Chip8::_dxyn;
-    table[0xE] = &Chip8::TableE;
-    table[0xF] = &Chip8::TableF;
-
-    table0[0x0] = &Chip8::_00e0;
-    table0[0xE] = &Chip8::_00ee;
-
-    table8[0x0] = &Chip8::_8xy0;
-    table8[0x1] = &Chip8::_8xy1;
-    table8[0x2] = &Chip8::_8xy2;
-    table8[0x3] = &Chip8::_8xy3;
-    table8[0x4] = &Chip8::_8xy4;
-    table8[0x5] = &Chip8::_8xy5;
-    table8[0x6] = &Chip8::_8xy6;
-    table8[0x7] = &Chip8::_8xy7;
-    table8[0xE] = &Chip8::_8xyE;
-
-    tableE[0x1] = &Chip8::_exa1;
-    tableE[0xE] = &Chip8::_ex9e;
-
-    tableF[0x07] = &Chip8::_fx07;
-    tableF[0x0A] = &Chip8::_fx0a;
-    tableF[0x15] = &Chip8::_fx15;
-    tableF[0x18] = &Chip8::_fx18;
-    tableF[0x1E] = &Chip8::_fx1e;
-    tableF[0x29] = &Chip8::_fx29;
-    tableF[0x33] = &Chip8::_fx33;
-    tableF[0x55] = &Chip8::_fx55;
-    tableF[0x65] = &Chip8::_fx65;
+    // Bind every decoded op (see op.hpp) to its implementation. Group entries
+    // chain to the second level tables
+    Chip8Func exec[OP_COUNT];
+
+    exec[OP_INVALID] = &Chip8::OP_NULL;
+    exec[OP_GROUP0] = &Chip8::Table0;
+    exec[OP_GROUP8] = &Chip8::Table8;
+    exec[OP_GROUPE] = &Chip8::TableE;
+    exec[OP_GROUPF] = &Chip8::TableF;
+
+    exec[OP_00E0] = &Chip8::_00e0;
+    exec[OP_00EE] = &Chip8::_00ee;
+    exec[OP_1NNN] = &Chip8::_1nnn;
+    exec[OP_2NNN] = &Chip8::_2nnn;
+    exec[OP_3XKK] = &Chip8::_3xkk;
+    exec[OP_4XKK] = &Chip8::_4xkk;
+    exec[OP_5XY0] = &Chip8::_5xy0;
+    exec[OP_6XKK] = &Chip8::_6xkk;
+    exec[OP_7XKK] = &Chip8::_7xkk;
+    exec[OP_8XY0] = &Chip8::_8xy0;
+    exec[OP_8XY1] = &Chip8::_8xy1;
+    exec[OP_8XY2] = &Chip8::_8xy2;
+    exec[OP_8XY3] = &Chip8::_8xy3;
+    exec[OP_8XY4] = &Chip8::_8xy4;
+    exec[OP_8XY5] = &Chip8::_8xy5;
+    exec[OP_8XY6] = &Chip8::_8xy6;
+    exec[OP_8XY7] = &Chip8::_8xy7;
+    exec[OP_8XYE] = &Chip8::_8xyE;
+    exec[OP_9XY0] = &Chip8::_9xy0;
+    exec[OP_ANNN] = &Chip8::_annn;
+    exec[OP_BNNN] = &Chip8::_bnnn;
+    exec[OP_CXKK] = &Chip8::_cxkk;
+    exec[OP_DXYN] = &Chip8::_dxyn;
+    exec[OP_EX9E] = &Chip8::_ex9e;
+    exec[OP_EXA1] = &Chip8::_exa1;
+    exec[OP_FX07] = &Chip8::_fx07;
+    exec[OP_FX0A] = &Chip8::_fx0a;
+    exec[OP_FX15] = &Chip8::_fx15;
+    exec[OP_FX18] = &Chip8::_fx18;
+    exec[OP_FX1E] = &Chip8::_fx1e;
+    exec[OP_FX29] = &Chip8::_fx29;
+    exec[OP_FX33] = &Chip8::_fx33;
+    exec[OP_FX55] = &Chip8::_fx55;
+    exec[OP_FX65] = &Chip8::_fx65;
+
+    for (size_t i = 0; i < OP_TABLE_SIZE; ++i) table[i] = exec[opTable[i]];
+    for (size_t i = 0; i < OP_TABLE0_SIZE; ++i) table0[i] = exec[opTable0[i]];
+    for (size_t i = 0; i < OP_TABLE8_SIZE; ++i) table8[i] = exec[opTable8[i]];
+    for (size_t i = 0; i < OP_TABLEE_SIZE; ++i) tableE[i] = exec[opTableE[i]];
+    for (size_t i = 0; i < OP_TABLEF_SIZE; ++i) tableF[i] = exec[opTableF[i]];
 }
 
 void Chip8::loadROM(std::string aROMName) {
@@ -110,50 +150,417 @@ void Chip8::loadROM(std::string aROMName) {
     rom.close();
 }
 
-void Chip8::emulate() {
-    int videoPitch = sizeof(gfx[0]) * GFX_WIDTH;
-	auto lastCycleTime = std::chrono::high_resolution_clock::now();
-    int cycleDelay = std::stoi("10");
-    unsigned int tock = 0;
+bool Chip8::loadNative(std::string aPath) {
+    void* module = dlopen(aPath.c_str(), RTLD_NOW | RTLD_LOCAL);
+
+    if (!module) {
+        std::cerr << "Failed to load native module: " << dlerror() << std::endl;
+        return false;
+    }
+
+    auto blocks = (NativeBlock const*)dlsym(module, "chip8_native_blocks");
+    auto rom = (uint8_t const*)dlsym(module, "chip8_native_rom");
+    auto romSize = (uint16_t const*)dlsym(module, "chip8_native_rom_size");
+    auto abi = (unsigned int const*)dlsym(module, "chip8_native_abi");
+
+    if (!abi || *abi != NATIVE_ABI) {
+        std::cerr << "Native module was built for another version, regenerate it" << std::endl;
+        dlclose(module);
+        return false;
+    }
+
+    // The module is only valid for the exact ROM it was compiled from
+    if (!blocks || !rom || !romSize || *romSize > MAX_MEM - MEM_LO ||
+        memcmp(rom, memory + MEM_LO, *romSize) != 0) {
+        std::cerr << "Native module does not match the loaded ROM" << std::endl;
+        dlclose(module);
+        return false;
+    }
+
+    std::shared_ptr<NativeMap> map(new NativeMap{});
+    map->module.reset(module, dlclose);
+
+    for (NativeBlock const* block = blocks; block->run; ++block) {
+        map->blocks[block->start & MEM_HI] = block;
+
+        for (uint16_t a = block->start; a < block->end && a < MAX_MEM; ++a) {
+            map->owner[a] = block->start + 1;
+        }
+    }
+
+    native = map;
+    return true;
+}
+
+void Chip8::invalidateNative(uint16_t aAddress, unsigned int aLength) {
+    if (!native) {
+        return;
+    }
 
-    while (!quit) {
-        quit = gfxHandle->input(key);
+    for (unsigned int i = 0; i < aLength; ++i) {
+        uint16_t owner = native->owner[(aAddress + i) & MEM_HI];
+
+        if (owner && native->blocks[owner - 1]) {
+            // Copy on write; other forks still run the original code
+            if (native.use_count() > 1) {
+                native.reset(new NativeMap(*native));
+            }
+
+            native->blocks[owner - 1] = nullptr;
+        }
+    }
+}
+
+void Chip8::emulate(Frontend& aFrontend) {
+    auto const frameTime = std::chrono::microseconds(1000000 / FRAME_RATE);
+    auto nextFrame = std::chrono::steady_clock::now();
+
+    // Run-ahead bookkeeping, reported on exit
+    bool speculate = runAhead && !debugger;
+    uint64_t realInsts = 0;
+    uint64_t aheadInsts = 0;
+    std::chrono::steady_clock::duration aheadTime{};
+    auto start = std::chrono::steady_clock::now();
+
+    if (speculate && !runAheadState) {
+        runAheadState.reset(new Snapshot);
+    }
+
+    while (!quit && !fault.kind) {
+        auto frameStart = std::chrono::steady_clock::now();
+
+        if (metrics) {
+            metrics->frameJitter.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                frameStart - std::min(frameStart, nextFrame)).count());
+        }
+
+        // Never clear a quit requested from another thread
+        if (aFrontend.input(key)) {
+            quit = true;
+        }
+
+        auto inputEnd = std::chrono::steady_clock::now();
+        unsigned int executed = frame();
+        realInsts += executed;
+        captureFrame(false);
+
+        auto updateStart = std::chrono::steady_clock::now();
+
+        if (speculate) {
+            // Show where the game will be runAhead frames from now if the
+            // input stays the same, then return to the real timeline
+            save(*runAheadState);
+
+            for (unsigned int i = 0; i < runAhead; ++i) {
+                aheadInsts += frame();
+            }
+
+            aFrontend.update(gfx);
+            restore(*runAheadState);
+            aheadTime += std::chrono::steady_clock::now() - updateStart;
+        } else {
+            aFrontend.update(gfx);
+        }
+
+        // Run-ahead's speculative frames are part of the cost of presenting
+        if (metrics) {
+            metrics->updateTime.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - updateStart).count());
+        }
 
-		auto currentTime = std::chrono::high_resolution_clock::now();
-		float dt = std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - lastCycleTime).count();
+        // Sleep instead of spinning until the next frame is due. Frames where
+        // the ROM is idle execute nothing, so a waiting game costs almost no CPU
+        nextFrame += frameTime;
+        auto now = std::chrono::steady_clock::now();
 
-		if (dt > cycleDelay) {
-			lastCycleTime = currentTime;
-            tick();
-            gfxHandle->update(gfx, videoPitch);
-            ++tock;
+        if (metrics) {
+            metrics->inputTime.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                inputEnd - frameStart).count());
+            metrics->instsPerFrame.record(executed);
+            bump(metrics->frames);
         }
+
+        if (now < nextFrame) {
+            std::this_thread::sleep_until(nextFrame);
+        } else {
+            if (metrics) {
+                bump(metrics->lateFrames);
+            }
+
+            if (now - nextFrame > frameTime) {
+                // Fell behind (e.g. stopped in the debugger), don't try to catch up
+                if (metrics) {
+                    bump(metrics->droppedFrames, (now - nextFrame) / frameTime);
+                }
+
+                nextFrame = now;
+            }
+        }
+    }
+
+    if (speculate) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double aheadSeconds = std::chrono::duration<double>(aheadTime).count();
+
+        std::cout << "run-ahead " << runAhead << ": " << realInsts / seconds
+                  << " real instructions/s, " << aheadInsts / seconds
+                  << " speculative instructions/s, " << 100 * aheadSeconds / seconds
+                  << "% of wall time spent ahead" << std::endl;
+    }
+
+    if (fault.kind) {
+        std::cerr << describe(fault) << std::endl;
+    }
+}
+
+uint64_t Chip8::runFrames(uint64_t aFrames) {
+    uint64_t executed = 0;
+    uint64_t done = 0;
+
+    while (done < aFrames && !quit && !fault.kind) {
+        bool debugging = debugger && debugger->active();
+
+        if (wait == WAIT_TIMER && delayTimer && !debugging) {
+            // Jump straight to the timer expiry
+            uint64_t skip = std::min<uint64_t>(delayTimer, aFrames - done);
+            advanceTimers(skip);
+            done += skip;
+        } else if (wait == WAIT_KEY && !keyPressed() && !debugging) {
+            // Keys cannot change while running headless, nothing will wake it
+            advanceTimers(aFrames - done);
+            done = aFrames;
+        } else {
+            executed += frame();
+            // No real-time constraint here, so every change is recorded
+            captureFrame(true);
+            ++done;
+        }
+    }
+
+    return executed;
+}
+
+unsigned int Chip8::frame() {
+    unsigned int executed = 0;
+
+    if (beginFrame()) {
+        if (debugger && debugger->active()) {
+            executed = debugger->run(CYCLES_PER_FRAME);
+        } else {
+            executed = run(CYCLES_PER_FRAME);
+        }
+    }
+
+    advanceTimers(1);
+
+    return executed;
+}
+
+bool Chip8::beginFrame() {
+    // The debugger goes first so breaks and steps are handled while the ROM
+    // waits. It executes the wait instruction again, which sets wait again
+    if (debugger && debugger->active()) {
+        wait = WAIT_NONE;
+    } else if (idle()) {
+        return false;
+    }
+
+    yield = fault.kind;
+    return true;
+}
+
+bool Chip8::idle() {
+    switch (wait) {
+        case WAIT_TIMER:
+            if (delayTimer) {
+                return true;
+            }
+            break;
+        case WAIT_KEY:
+            if (!keyPressed()) {
+                return true;
+            }
+            break;
+        case WAIT_NONE:
+            return false;
+    }
+
+    wait = WAIT_NONE;
+    return false;
+}
+
+bool Chip8::keyPressed() const {
+    for (uint8_t k : key) {
+        if (k) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Chip8::advanceTimers(uint64_t aFrames) {
+    delayTimer -= std::min<uint64_t>(delayTimer, aFrames);
+    sndTimer -= std::min<uint64_t>(sndTimer, aFrames);
+    frameCount += aFrames;
+}
+
+// splitmix64 finaliser
+static uint64_t mix(uint64_t aValue) {
+    aValue = (aValue ^ (aValue >> 30)) * 0xBF58476D1CE4E5B9ull;
+    aValue = (aValue ^ (aValue >> 27)) * 0x94D049BB133111EBull;
+    return aValue ^ (aValue >> 31);
+}
+
+// Row hashes are salted by position so identical rows do not cancel out
+static uint64_t rowHash(unsigned int aRow, uint64_t aBits) {
+    return aBits ? mix(aBits + (aRow + 1) * 0x9E3779B97F4A7C15ull) : 0;
+}
+
+// Only comparisons pay for this, so memory writes stay plain stores
+uint64_t Chip8::stateHash() const {
+    uint64_t hash = mix(gfxHash + 1);
+
+    auto add = [&](uint64_t aValue) {
+        hash = mix(hash + aValue + 0x9E3779B97F4A7C15ull);
+    };
+
+    // Multiply-rotate over words; the final mix below spreads it
+    uint64_t memoryHash = 0;
+
+    for (unsigned int i = 0; i < MAX_MEM; i += 8) {
+        uint64_t word;
+        memcpy(&word, memory + i, 8);
+        memoryHash = ((memoryHash ^ word) * 0x9E3779B97F4A7C15ull);
+        memoryHash = memoryHash << 29 | memoryHash >> 35;
+    }
+
+    add(memoryHash);
+
+    for (unsigned int i = 0; i < NUM_REGS; i += 8) {
+        uint64_t word = 0;
+        memcpy(&word, V + i, 8);
+        add(word);
+    }
+
+    for (unsigned int i = 0; i < STACK_SIZE; i += 4) {
+        uint64_t word = 0;
+        memcpy(&word, stack + i, 8);
+        add(word);
+    }
+
+    add(uint64_t(I) << 48 | uint64_t(pc) << 32 | uint64_t(sp) << 16 |
+        delayTimer << 8 | sndTimer);
+    add(uint64_t(wait) << 56 | uint64_t(fault.kind) << 48 | uint64_t(fault.pc) << 32 |
+        uint64_t(fault.opcode) << 16 | fault.I);
+    add(uint64_t(rng) << 32 | drawCount);
+    add(frameCount);
+
+    return hash;
+}
+
+void Chip8::setRow(unsigned int aRow, uint64_t aBits) {
+    gfxHash ^= rowHash(aRow, rows[aRow]) ^ rowHash(aRow, aBits);
+    rows[aRow] = aBits;
+}
+
+void Chip8::logDraw() {
+    if (drawLog) {
+        drawLog->push_back(DrawRecord{uint16_t(pc - 2), opcode, gfxHash});
     }
 }
 
+void Chip8::setCapture(Capture* aCapture) {
+    captureFrame(true);
+    capture = aCapture;
+    capturedDraws = drawCount - 1;
+}
+
+void Chip8::captureFrame(bool aWait) {
+    // A refused frame stays pending, so the next attempt records whatever the
+    // screen shows then
+    if (capture && drawCount != capturedDraws && capture->push(gfx, frameCount, aWait)) {
+        capturedDraws = drawCount;
+    }
+}
+
+unsigned int Chip8::run(unsigned int aCycles) {
+    unsigned int i = 0;
+
+    yield = fault.kind;
+
+    if (native) {
+        return runNative(aCycles);
+    }
+
+    for (; i < aCycles && !yield; ++i) {
+        tick();
+    }
+
+    return i;
+}
+
+unsigned int Chip8::runNative(unsigned int aCycles) {
+    unsigned int i = 0;
+
+    while (i < aCycles && !yield) {
+        i += step(aCycles - i);
+    }
+
+    return i;
+}
+
+NativeBlock const* Chip8::nativeBlock() const {
+    if (!native) {
+        return nullptr;
+    }
+
+    uint16_t owner = native->owner[pc & MEM_HI];
+
+    // Entering between two instructions is left to the interpreter
+    if (!owner || ((pc - (owner - 1)) & 1)) {
+        return nullptr;
+    }
+
+    return native->blocks[owner - 1];
+}
+
+// Blocks are entered at any instruction and stop when the budget runs out, so
+// instruction counts (and therefore timer ticks) match the interpreter exactly
+// and a frame boundary inside a block costs nothing
+unsigned int Chip8::step(unsigned int aBudget) {
+    NativeBlock const* block = nativeBlock();
+    unsigned int executed = block ? block->run(*this, aBudget) : 0;
+
+    if (!executed) {
+        tick();
+        executed = 1;
+    }
+
+    return executed;
+}
+
 // Simulate 1 clock tick
 void Chip8::tick() {
     // Fetch
-	opcode = (memory[pc] << 8u) | memory[pc + 1];
+	opcode = (memory[pc & MEM_HI] << 8u) | memory[(pc + 1) & MEM_HI];
 
-	#ifdef NDEBUG
+	#ifdef DEBUG
 	std::cout << "pc = " << pc << ", opcode = " << opcode << std::endl;
 	#endif
+
+	if (coverage) {
+		// Hash the address so neighbouring instructions spread over the map
+		uint16_t location = ((pc & MEM_HI) * 0x9E37u) & (COVERAGE_SIZE - 1);
+		++coverage[location ^ prevLocation];
+		prevLocation = location >> 1;
+	}
+
 	// Increment the PC before we execute anything
 	pc += 2;
 
 	// Decode and Execute
 	((*this).*(table[(opcode & 0xF000u) >> 12u]))();
-
-	// Decrement the delay timer if it's been set
-	if (delayTimer > 0) {
-		--delayTimer;
-	}
-
-	// Decrement the sound timer if it's been set
-	if (sndTimer > 0) {
-		--sndTimer;
-	}
 }
 
 void Chip8::dumpMemory() const {
@@ -166,6 +573,36 @@ void Chip8::error(std::string aMessage) const {
     exit(1);
 }
 
+// Only the first fault is kept; the run loops stop as soon as one is set
+void Chip8::raiseTrap(TrapKind aKind) {
+    if (!fault.kind) {
+        fault = Trap{aKind, uint16_t(pc - 2), opcode, I, sp};
+    }
+
+    yield = true;
+}
+
+std::string describe(Trap const& aTrap) {
+    static char const* const names[] = {
+        "none", "illegal opcode", "stack overflow", "stack underflow",
+        "memory access out of bounds"
+    };
+
+    char text[128];
+    snprintf(text, sizeof(text), "trap: %s at pc=0x%03X opcode=0x%04X I=0x%03X sp=%u",
+             names[aTrap.kind], aTrap.pc, aTrap.opcode, aTrap.I, aTrap.sp);
+    return text;
+}
+
+void packScreen(uint8_t const* aScreen, uint8_t* aPacked) {
+    for (unsigned int i = 0; i < PACKED_SCREEN_SIZE; ++i) {
+        uint8_t const* pixels = aScreen + i * 8;
+        aPacked[i] = (!!pixels[0] << 7) | (!!pixels[1] << 6) | (!!pixels[2] << 5) |
+                     (!!pixels[3] << 4) | (!!pixels[4] << 3) | (!!pixels[5] << 2) |
+                     (!!pixels[6] << 1) | !!pixels[7];
+    }
+}
+
 // Instructions defined below
 
 // 0nnn - SYS addr
@@ -181,6 +618,13 @@ void Chip8::_00e0() {
 		std::cout << "\t00e0" << std::endl;
 	#endif
     memset((char*)gfx, 0, sizeof(gfx));
+    ++drawCount;
+
+    for (unsigned int row = 0; row < GFX_HEIGHT; ++row) {
+        setRow(row, 0);
+    }
+
+    logDraw();
 }
 
 // 00EE - RET
@@ -191,7 +635,12 @@ void Chip8::_00ee() {
 	#endif
     // Decrement stack pointer, pop the stack and set PC to instruction at the
     // top of the newly popped stack
-    pc = stack[--sp];
+    if (sp == 0) {
+        raiseTrap(TRAP_STACK_UNDERFLOW);
+        return;
+    }
+
+    pc = stack[--sp & (STACK_SIZE - 1)];
 }
 
 // 1nnn - JP addr
@@ -209,8 +658,12 @@ void Chip8::_2nnn() {
 	#ifdef DEBUG
 		std::cout << "\t2nnn" << std::endl;
 	#endif
-    stack[sp] = pc;
-	++sp;
+    if (sp >= STACK_SIZE) {
+        raiseTrap(TRAP_STACK_OVERFLOW);
+        return;
+    }
+
+    stack[sp++ & (STACK_SIZE - 1)] = pc;
     pc = opcode & 0x0FFFu;
 }
 
@@ -443,6 +896,12 @@ void Chip8::_bnnn() {
 		std::cout << "\tbnnn" << std::endl;
 	#endif
     uint16_t address = opcode & 0x0FFFu;
+
+	if (V[0] + address > MEM_HI) {
+		raiseTrap(TRAP_MEMORY_BOUNDS);
+		return;
+	}
+
 	pc = V[0] + address;
 }
 
@@ -455,7 +914,7 @@ void Chip8::_cxkk() {
     uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t byte = opcode & 0x00FFu;
 
-	V[Vx] = rand(randGen) & byte;
+	V[Vx] = random() & byte;
 }
 
 // Dxyn - DRW Vx, Vy, nibble
@@ -473,27 +932,46 @@ void Chip8::_dxyn() {
 	uint8_t xPos = V[Vx] % GFX_WIDTH;
 	uint8_t yPos = V[Vy] % GFX_HEIGHT;
 
+	// One bounds check per instruction; the accesses below are masked
+	if (I + height > MAX_MEM) {
+		raiseTrap(TRAP_MEMORY_BOUNDS);
+		return;
+	}
+
 	V[0xF] = 0;
+	++drawCount;
 
 	for (unsigned int row = 0; row < height; ++row) {
-		uint8_t spriteByte = memory[I + row];
+		uint8_t spriteByte = memory[(I + row) & MEM_HI];
+		unsigned int y = (yPos + row) & (GFX_HEIGHT - 1);
+		uint8_t* screenRow = &gfx[y * GFX_WIDTH];
+
+		// The sprite byte placed at xPos, wrapping around the row
+		uint64_t bits = uint64_t(spriteByte) << 56;
+		bits = (bits >> xPos) | (bits << ((GFX_WIDTH - xPos) & (GFX_WIDTH - 1)));
+
+		if (bits) {
+			setRow(y, rows[y] ^ bits);
+		}
 
 		for (unsigned int col = 0; col < 8; ++col) {
 			uint8_t spritePixel = spriteByte & (0x80u >> col);
-			uint32_t* screenPixel = &gfx[(yPos + row) * GFX_WIDTH + (xPos+col)];
+			uint8_t* screenPixel = &screenRow[(xPos + col) & (GFX_WIDTH - 1)];
 
 			// Sprite pixel is on
 			if (spritePixel) {
 				// Screen pixel also on - collision
-				if (*screenPixel == 0xFFFFFFFF) {
+				if (*screenPixel) {
 					V[0xF] = 1;
 				}
 
 				// Effectively XOR with the sprite pixel
-				*screenPixel ^= 0xFFFFFFFF;
+				*screenPixel ^= 1;
 			}
 		}
 	}
+
+	logDraw();
 }
 
 // Ex9E - SKP Vx
@@ -503,7 +981,7 @@ void Chip8::_ex9e() {
 		std::cout << "\tex9e" << std::endl;
 	#endif
     uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t k = V[Vx];
+	uint8_t k = V[Vx] & 0xFu;
 
 	if (key[k]) {
 		pc += 2;
@@ -517,7 +995,7 @@ void Chip8::_exa1() {
 		std::cout << "\texa1" << std::endl;
 	#endif
     uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t k = V[Vx];
+	uint8_t k = V[Vx] & 0xFu;
 
 	if (!key[k]) {
 		pc += 2;
@@ -532,6 +1010,16 @@ void Chip8::_fx07() {
 	#endif
     uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	V[Vx] = delayTimer;
+
+	// "Fx07; 3x00; 1nnn" jumping back here spins until the delay timer runs
+	// out. Rewind and sleep until then instead of executing the loop
+	if (delayTimer &&
+	    memory[pc & MEM_HI] == (0x30u | Vx) && memory[(pc + 1) & MEM_HI] == 0 &&
+	    uint16_t((memory[(pc + 2) & MEM_HI] << 8u) | memory[(pc + 3) & MEM_HI]) == uint16_t(0x1000u | (pc - 2))) {
+		pc -= 2;
+		wait = WAIT_TIMER;
+		yield = true;
+	}
 }
 
 // Fx0A - LD Vx, K
@@ -575,7 +1063,10 @@ void Chip8::_fx0a() {
 	} else if (key[15]) {
 		V[Vx] = 15;
 	} else {
+		// Nothing to do until a key arrives
 		pc -= 2;
+		wait = WAIT_KEY;
+		yield = true;
 	}
 }
 
@@ -616,7 +1107,7 @@ void Chip8::_fx29() {
 		std::cout << "\tfx29" << std::endl;
 	#endif
     uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t digit = V[Vx];
+	uint8_t digit = V[Vx] & 0xFu;
 
 	I = MEM_FNT + (5 * digit);
 }
@@ -630,16 +1121,25 @@ void Chip8::_fx33() {
     uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t value = V[Vx];
 
+	if (I + 2 > MEM_HI) {
+		raiseTrap(TRAP_MEMORY_BOUNDS);
+		return;
+	}
+
 	// Ones-place
-	memory[I + 2] = value % 10;
+	memory[(I + 2) & MEM_HI] = value % 10;
 	value /= 10;
 
 	// Tens-place
-	memory[I + 1] = value % 10;
+	memory[(I + 1) & MEM_HI] = value % 10;
 	value /= 10;
 
 	// Hundreds-place
-	memory[I] = value % 10;
+	memory[I & MEM_HI] = value % 10;
+
+	if (native) {
+		invalidateNative(I, 3);
+	}
 }
 
 // Fx55 - LD [I], Vx
@@ -650,8 +1150,17 @@ void Chip8::_fx55() {
 	#endif
     uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
+	if (I + Vx > MEM_HI) {
+		raiseTrap(TRAP_MEMORY_BOUNDS);
+		return;
+	}
+
 	for (uint8_t i = 0; i <= Vx; ++i) {
-		memory[I + i] = V[i];
+		memory[(I + i) & MEM_HI] = V[i];
+	}
+
+	if (native) {
+		invalidateNative(I, Vx + 1);
 	}
 }
 
@@ -663,8 +1172,13 @@ void Chip8::_fx65() {
 	#endif
     uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
+	if (I + Vx > MEM_HI) {
+		raiseTrap(TRAP_MEMORY_BOUNDS);
+		return;
+	}
+
 	for (uint8_t i = 0; i <= Vx; ++i) {
-		V[I] = memory[I + i];
+		V[i] = memory[(I + i) & MEM_HI];
 	}
 }
 
@@ -1,88 +1,308 @@
-#include <random>
+#pragma once
+
+#include <atomic>
+#include <memory>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 #include "common.hpp"
-#include "gfx.hpp"
 #include "op.hpp"
 
 namespace chip8 {
-class Chip8 final {
+class Debugger;
+class Capture;
+class Frontend;
+struct Metrics;
+
+// Faults raised by a misbehaving ROM. Memory, stack and framebuffer accesses
+// are masked so execution can never leave the machine's arrays; a faulting
+// instruction stops before any side effect and the trap records what went
+// wrong so the runner can halt and report it
+enum TrapKind : uint8_t {
+    TRAP_NONE,
+    TRAP_ILLEGAL_OPCODE,
+    TRAP_STACK_OVERFLOW,
+    TRAP_STACK_UNDERFLOW,
+    TRAP_MEMORY_BOUNDS
+};
+
+struct Trap {
+    TrapKind kind;
+    // Address and opcode of the faulting instruction
+    uint16_t pc;
+    uint16_t opcode;
+    uint16_t I;
+    uint16_t sp;
+};
+
+std::string describe(Trap const& aTrap);
+
+// Pack a one byte per pixel screen into PACKED_SCREEN_SIZE bytes: rows top to
+// bottom, most significant bit leftmost
+void packScreen(uint8_t const* aScreen, uint8_t* aPacked);
+
+// Wait idioms detected by the core. While one is pending, frames execute no
+// instructions until the timer expires or a key is down
+enum Wait : uint8_t {
+    WAIT_NONE,
+    WAIT_TIMER,
+    WAIT_KEY
+};
+
+// Everything that decides how a machine evolves, as plain data. Copying one is
+// a memcpy, which is all saving, restoring and cloning a machine amount to
+struct State {
+    // CHIP-8 has a maximum memory space of 4K bytes. Historically the first 512
+    // bytes of memory (0x200) were reserved for the emulator. Uppermost 256 bytes
+    // are reserved for display refresh. Following 96 bytes usually reserved for
+    // call stack and other internal use
+    uint8_t memory[MAX_MEM];
+
+    // CHIP-8 graphics screen is 64x32 pixels where sprites are XORed. One
+    // byte per pixel (0 or 1); the frontend colorizes it at presentation time
+    uint8_t gfx[GFX_WIDTH * GFX_HEIGHT];
+
+    // Return addresses are 12 bits wide. The stack holds 16 levels; sp is
+    // masked on every access and over/underflow raises a trap
+    uint16_t stack[STACK_SIZE];
+
+    // CHIP-8 has 16 b-bit registers V0-VF. The VF register usually stores (carry)
+    // flags and should not be used as a general purpose register
+    uint8_t V[NUM_REGS];
+
+    // Address register is 16 bits wide
+    uint16_t I;
+    uint16_t pc;
+    uint16_t sp;
+
+    // CHIP-8 opcodes are 2 bytes long
+    uint16_t opcode;
+
+    // Timers used for events and sounds
+    uint8_t delayTimer;
+    uint8_t sndTimer;
+
+    // Map 16 input keys to a state array
+    uint8_t key[MAX_KEYS];
+
+    Wait wait;
+
+    // End the current run early (trap or wait)
+    bool yield;
+
+    Trap fault;
+
+    // Hashed previous location for edge coverage
+    uint16_t prevLocation;
+
+    // Bumped by every instruction that touches gfx, so observers can tell
+    // whether the screen changed without comparing it
+    uint32_t drawCount;
+
+    // gfx again, one row per word with the leftmost pixel in the top bit, and
+    // a hash of the whole screen. Both are kept up to date by 00E0 and Dxyn;
+    // a blank screen hashes to 0
+    uint64_t rows[GFX_HEIGHT];
+    uint64_t gfxHash;
+
+    // Some instructions in the CHIP-8 ISA rely on a random number value.
+    // In hardware this is usually accomplished with a dedicated chip or
+    // reading a noisy signal. Here it is a xorshift32 generator, never 0
+    uint32_t rng;
+
+    // Frames emulated since boot
+    uint64_t frameCount;
+};
+
+static_assert(std::is_trivially_copyable<State>::value, "State must stay plain data");
+
+// A draw instruction and the screen hash it left behind
+struct DrawRecord {
+    uint16_t pc;
+    uint16_t opcode;
+    uint64_t hash;
+};
+
+class Chip8;
+
+// One block of an ahead-of-time compiled module (see Recompiler). run enters
+// the block at the current pc, which may be any instruction in [start, end),
+// executes at most aBudget instructions and returns how many it completed; it
+// stops early if the machine yields
+struct NativeBlock {
+    uint16_t start;
+    uint16_t end;
+    uint16_t length;
+    unsigned int (*run)(Chip8&, unsigned int aBudget);
+};
+
+// Modules record the value they were built with; bump it whenever NativeBlock
+// or State changes so stale modules are refused instead of misbehaving
+#define NATIVE_ABI 3
+
+// The machine State plus host-side attachments (debugger, coverage map,
+// compiled blocks). Copying a Chip8 forks the running machine: the state is
+// copied, a native module is shared, and host attachments are left behind.
+class Chip8 final : private State {
     public:
+        // Saved machines are plain copies of the State
+        typedef State Snapshot;
+
         Chip8(std::string aROMName);
-        ~Chip8();
-        void emulate();
+        Chip8(Chip8 const& aOther);
+
+        // Run in real time, presenting every frame to aFrontend until it quits
+        void emulate(Frontend& aFrontend);
+
+        std::unique_ptr<Chip8> clone() const { return std::unique_ptr<Chip8>(new Chip8(*this)); }
+
+        // Route execution through a debugger. Its checked loop is only used
+        // while it has breakpoints, watchpoints or a pending stop; otherwise
+        // the plain loop below runs
+        void attach(Debugger* aDebugger) { debugger = aDebugger; }
+
+        // Record frame pacing and presentation timings from emulate()
+        void setMetrics(Metrics* aMetrics) { metrics = aMetrics; }
+
+        // Hand every frame that changed the screen to aCapture, from both
+        // emulate() and runFrames(). The first frame is always recorded, and
+        // the final screen is handed to the previous capture when it is
+        // replaced or detached
+        void setCapture(Capture* aCapture);
+
+        // Emulate aFrames frames without a window as fast as possible,
+        // skipping over idle waits. Returns the instructions executed
+        uint64_t runFrames(uint64_t aFrames);
+
+        // Emulate one 60 Hz frame: CYCLES_PER_FRAME instructions (fewer if the
+        // ROM goes idle or traps), then a timer tick
+        unsigned int frame();
+
+        // Execute up to aCycles instructions with no debug checks. Stops early
+        // if the machine traps or starts waiting. Returns the count executed
+        unsigned int run(unsigned int aCycles);
+
+        // Execute through an ahead-of-time compiled module for this ROM.
+        // Blocks it does not cover, computed jump targets and code the ROM
+        // overwrites fall back to the interpreter
+        bool loadNative(std::string aPath);
+
+        // Key state as a bitmask, bit n = key n down
+        void setKeys(uint16_t aMask) {
+            for (int i = 0; i < MAX_KEYS; ++i) {
+                key[i] = (aMask >> i) & 1u;
+            }
+        }
+
+        // One byte per pixel, GFX_WIDTH * GFX_HEIGHT
+        uint8_t const* framebuffer() const { return gfx; }
+
+        // Read-only view of the whole machine
+        State const& state() const { return *this; }
+
+        // Hash of everything in the state that decides how the machine
+        // evolves. Memory is hashed on demand, the screen through gfxHash
+        uint64_t stateHash() const;
+
+        // Make Cxkk reproducible
+        void seed(uint32_t aSeed) { rng = aSeed ? aSeed : 1; }
+
+        // Append every 00E0 and Dxyn executed to aLog. nullptr turns logging off
+        void setDrawLog(std::vector<DrawRecord>* aLog) { drawLog = aLog; }
+
+        // Count control-flow edges into aMap (COVERAGE_SIZE bytes, AFL style)
+        // from tick(). nullptr turns tracking off. Native blocks are not traced
+        void setCoverage(uint8_t* aMap) { coverage = aMap; }
+
+        // kind is TRAP_NONE while the machine is healthy
+        Trap const& lastTrap() const { return fault; }
+
+        void save(Snapshot& aSnapshot) const { aSnapshot = *this; }
+        void restore(Snapshot const& aSnapshot) { static_cast<State&>(*this) = aSnapshot; }
+
+        // Present the frame aFrames ahead of the real one, predicted with the
+        // current input, then roll back. Hides that many frames of latency
+        void setRunAhead(unsigned int aFrames) { runAhead = aFrames; }
     private:
+        friend class Debugger;
+        friend class GdbStub;
+        friend class Lockstep;
+        friend struct Golden;
+        // Generated code in AOT modules calls the instruction handlers directly
+        friend struct Native;
+
         void boot();
-        void loadInsts();
+        static void loadInsts();
         void tick();
         void loadROM(std::string aROMName);
         void error(std::string aMessage) const;
+        void raiseTrap(TrapKind aKind);
+
+        // frame() around its instructions: beginFrame() returns false if the
+        // frame executes none and otherwise readies the machine for them
+        bool beginFrame();
+        // True while the ROM is in a recognised wait loop
+        bool idle();
+        bool keyPressed() const;
+        void advanceTimers(uint64_t aFrames);
+        // aWait: block on a full capture queue instead of retrying next frame
+        void captureFrame(bool aWait);
+        // Replace row aRow of the packed screen, keeping gfxHash current
+        void setRow(unsigned int aRow, uint64_t aBits);
+        void logDraw();
+
+        unsigned int runNative(unsigned int aCycles);
+        // Execute the compiled block covering pc for up to aBudget
+        // instructions, or one interpreted instruction if there is none.
+        // Returns the count executed
+        unsigned int step(unsigned int aBudget);
+        // Compiled block with an instruction at pc, if any
+        NativeBlock const* nativeBlock() const;
+        // The ROM wrote to [aAddress, aAddress + aLength): drop any compiled
+        // block that covers it
+        void invalidateNative(uint16_t aAddress, unsigned int aLength);
 
         // Debugging facilities
         void dumpMemory() const;
 
-        // CHIP-8 opcodes are 2 bytes long
-        uint16_t opcode;
-
-        // CHIP-8 has a maximum memory space of 4K bytes. Historically the first 512
-        // bytes of memory (0x200) were reserved for the emulator. Uppermost 256 bytes
-        // are reserved for display refresh. Following 96 bytes usually reserved for
-        // call stack and other internal use
-       uint8_t memory[MAX_MEM];
-
-        // ROM files expect fonts to be installed at specific locations in memory
-        // Use the fonts array below at boot time to load font sprites
-        uint8_t fonts[FONTS_SIZE] = {
-            0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-            0x20, 0x60, 0x20, 0x20, 0x70, // 1
-            0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-            0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-            0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-            0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-            0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-            0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-            0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-            0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-            0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-            0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-            0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-            0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-            0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-            0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+        // Compiled blocks indexed by start address, and for each byte the start
+        // of the block covering it plus one (0 = none). Copies of a machine
+        // share the map until one of them has to invalidate a block
+        struct NativeMap {
+            std::shared_ptr<void> module;
+            NativeBlock const* blocks[MAX_MEM];
+            uint16_t owner[MAX_MEM];
         };
 
-        // CHIP-8 has 16 b-bit registers V0-VF. The VF register usually stores (carry)
-        // flags and should not be used as a general purpose register
-        uint8_t V[NUM_REGS]{};
+        std::shared_ptr<NativeMap> native;
 
-        // Address register is 16 bits wide
-        uint16_t I{};
-        uint16_t pc;
-        uint16_t sp{};
+        // Edge coverage map
+        uint8_t* coverage{};
 
-        // Original CHIP-8 stack size was 8 bytes
-        uint8_t stack[STACK_SIZE];
+        std::vector<DrawRecord>* drawLog{};
 
-        // CHIP-8 graphics screen is 64x32 pixels where sprites are XORed
-        uint32_t gfx[GFX_WIDTH * GFX_HEIGHT]{};
+        // Frames emulated ahead of the displayed one, and the state the real
+        // timeline is rolled back to
+        unsigned int runAhead{};
+        std::unique_ptr<Snapshot> runAheadState;
 
-        // Timers used for events and sounds
-        uint8_t delayTimer{};
-        uint8_t sndTimer{};
+        Debugger* debugger{};
+        Metrics* metrics{};
 
-        // Map 16 input keys to a state array
-        uint8_t key[MAX_KEYS]{};
+        Capture* capture{};
+        // drawCount when the last frame was captured
+        uint32_t capturedDraws{};
 
-        // Gfx handle
-        Gfx* gfxHandle;
+        // Set from other threads (GDB stub, frontends)
+        std::atomic<bool> quit{false};
 
-        bool quit;
-
-        // Some instructions in the CHIP-8 ISA rely on a random number value.
-        // In hardware this is usually accomplished with a dedicated chip or
-        // reading a noisy signal
-        std::uniform_int_distribution<uint8_t> rand;
-        std::default_random_engine randGen;
+        uint8_t random() {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            return rng >> 24;
+        }
 
         void Table0() {
             ((*this).*(table0[opcode & 0x000Fu]))();
@@ -100,14 +320,16 @@ class Chip8 final {
             ((*this).*(tableF[opcode & 0x00FFu]))();
         }
 
-        void OP_NULL() { }
+        void OP_NULL() {
+            raiseTrap(TRAP_ILLEGAL_OPCODE);
+        }
 
         typedef void (Chip8::*Chip8Func)();
-        Chip8Func table[0xF + 1]{&Chip8::OP_NULL};
-        Chip8Func table0[0xE + 1]{&Chip8::OP_NULL};
-        Chip8Func table8[0xE + 1]{&Chip8::OP_NULL};
-        Chip8Func tableE[0xE + 1]{&Chip8::OP_NULL};
-        Chip8Func tableF[0x65 + 1]{&Chip8::OP_NULL};
+        static Chip8Func table[OP_TABLE_SIZE];
+        static Chip8Func table0[OP_TABLE0_SIZE];
+        static Chip8Func table8[OP_TABLE8_SIZE];
+        static Chip8Func tableE[OP_TABLEE_SIZE];
+        static Chip8Func tableF[OP_TABLEF_SIZE];
 
         // Below are the 35 instructions defined by the CHIP-8 ISA
         void _0nnn();
@@ -2,11 +2,22 @@ namespace chip8 {
 #define MAX_MEM 4096
 #define NUM_REGS 16
 #define FONTS_SIZE 80
-#define STACK_SIZE 48
+#define STACK_SIZE 16
 #define GFX_WIDTH 64
 #define GFX_HEIGHT 32
 #define MAX_KEYS 16
 
+// Screen at 1 bit per pixel, see packScreen()
+#define PACKED_SCREEN_SIZE (GFX_WIDTH * GFX_HEIGHT / 8)
+
+// Timers count down at 60 Hz; the CPU runs a fixed number of instructions
+// between timer ticks
+#define FRAME_RATE 60
+#define CYCLES_PER_FRAME 10
+
+// Size of an edge coverage map
+#define COVERAGE_SIZE 0x10000
+
 // These memory offsets are to replicate reserved memory blocks iin original
 // CHIP-8 emulators
 #define MEM_LO 0x200
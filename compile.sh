@@ -1,2 +1,4 @@
 #!/bin/sh
-g++ *.cpp  -g -O0  -lSDL2_image `sdl2-config --libs --cflags`
+g++ *.cpp  -g -O0 -rdynamic -pthread -ldl -lrt -lSDL2_image `sdl2-config --libs --cflags`
+g++ `ls *.cpp | grep -v -e main.cpp -e gfx.cpp -e capture.cpp`  -g -O2 -shared -fPIC -pthread -ldl -lrt -o libchip8.so
+g++ tests/traps.cpp `ls *.cpp | grep -v -e main.cpp -e gfx.cpp -e capture.cpp`  -I. -g -O0 -pthread -ldl -lrt -o traps_test && ./traps_test
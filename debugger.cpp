@@ -0,0 +1,352 @@
+#include <csignal>
+#include <iomanip>
+#include <sstream>
+
+#include "debugger.hpp"
+
+namespace chip8 {
+// Terminal session that Ctrl-C breaks into
+static Debugger* interruptTarget;
+
+static void onInterrupt(int) {
+    if (interruptTarget) {
+        interruptTarget->requestBreak();
+    }
+}
+
+// Addresses and values are entered in hex, with or without a 0x prefix
+static bool parseHex(std::string const& aText, unsigned long& aValue) {
+    try {
+        size_t used = 0;
+        aValue = std::stoul(aText, &used, 16);
+        return used == aText.size();
+    } catch (...) {
+        return false;
+    }
+}
+
+Debugger::Debugger(Chip8& aChip8, std::istream& aIn, std::ostream& aOut)
+    : chip8(aChip8)
+    , in(aIn)
+    , out(aOut) {
+    chip8.attach(this);
+
+    // Ctrl-C breaks into the debugger instead of killing the emulator
+    interruptTarget = this;
+    std::signal(SIGINT, onInterrupt);
+
+    out << "CHIP-8 debugger, type 'h' for help" << std::endl;
+}
+
+Debugger::Debugger(Chip8& aChip8, StopHandler aHandler)
+    : chip8(aChip8)
+    , in(std::cin)
+    , out(std::cout)
+    , handler(aHandler)
+    , pause(false) {
+    chip8.attach(this);
+}
+
+Debugger::~Debugger() {
+    if (interruptTarget == this) {
+        std::signal(SIGINT, SIG_DFL);
+        interruptTarget = nullptr;
+    }
+
+    chip8.attach(nullptr);
+}
+
+void Debugger::addBreakpoint(uint16_t aAddress) {
+    if (!breakpoints[aAddress & MEM_HI]) {
+        breakpoints[aAddress & MEM_HI] = true;
+        ++numBreakpoints;
+    }
+}
+
+void Debugger::removeBreakpoint(uint16_t aAddress) {
+    if (breakpoints[aAddress & MEM_HI]) {
+        breakpoints[aAddress & MEM_HI] = false;
+        --numBreakpoints;
+    }
+}
+
+void Debugger::clearBreakpoints() {
+    breakpoints.reset();
+    numBreakpoints = 0;
+}
+
+unsigned int Debugger::run(unsigned int aCycles) {
+    unsigned int i = 0;
+
+    chip8.yield = chip8.fault.kind;
+
+    for (; i < aCycles && !chip8.quit && !chip8.yield; ++i) {
+        if (interrupt.exchange(false, std::memory_order_relaxed)) {
+            stop("interrupted");
+        } else if (pause) {
+            stop(pauseReason);
+        } else if (stepOver && chip8.pc == stepOverPc && chip8.sp == stepOverSp) {
+            stepOver = false;
+            stop("step");
+        } else if (breakpoints[chip8.pc & MEM_HI]) {
+            stop("breakpoint");
+        }
+
+        if (chip8.quit) {
+            break;
+        }
+
+        chip8.tick();
+
+        if (chip8.fault.kind) {
+            out << describe(chip8.fault) << std::endl;
+            stop("trap");
+            return i + 1;
+        }
+
+        if (checkWatches()) {
+            pause = true;
+            pauseReason = "watchpoint";
+        } else if (steps && --steps == 0) {
+            pause = true;
+            pauseReason = "step";
+        }
+    }
+
+    return i;
+}
+
+uint16_t Debugger::watchValue(Watch const& aWatch) const {
+    switch (aWatch.kind) {
+        case WATCH_MEM:
+            return chip8.memory[aWatch.index & MEM_HI];
+        case WATCH_REG:
+            return chip8.V[aWatch.index & 0xF];
+        case WATCH_I:
+            return chip8.I;
+    }
+
+    return 0;
+}
+
+std::string Debugger::watchName(Watch const& aWatch) const {
+    std::ostringstream name;
+    name << std::uppercase << std::hex;
+
+    switch (aWatch.kind) {
+        case WATCH_MEM:
+            name << "[0x" << std::setw(3) << std::setfill('0') << aWatch.index << "]";
+            break;
+        case WATCH_REG:
+            name << "V" << aWatch.index;
+            break;
+        case WATCH_I:
+            name << "I";
+            break;
+    }
+
+    return name.str();
+}
+
+bool Debugger::checkWatches() {
+    bool hit = false;
+
+    for (Watch& watch : watches) {
+        uint16_t value = watchValue(watch);
+
+        if (value != watch.last) {
+            out << "watch " << watchName(watch) << ": 0x" << std::hex << std::uppercase
+                << watch.last << " -> 0x" << value << std::dec << std::endl;
+            watch.last = value;
+            hit = true;
+        }
+    }
+
+    return hit;
+}
+
+void Debugger::stop(char const* aReason) {
+    pause = false;
+    steps = 0;
+
+    if (handler) {
+        handler(aReason);
+    } else {
+        prompt(aReason);
+    }
+}
+
+void Debugger::prompt(char const* aReason) {
+    out << aReason << " at ";
+    showCode(chip8.pc, 1);
+
+    std::string line;
+
+    while (!chip8.quit) {
+        out << "(chip8) " << std::flush;
+
+        if (!std::getline(in, line)) {
+            chip8.quit = true;
+            break;
+        }
+
+        if (command(line)) {
+            break;
+        }
+    }
+}
+
+// Returns true when the command resumes execution
+bool Debugger::command(std::string aLine) {
+    std::istringstream args(aLine);
+    std::string cmd, arg1, arg2;
+    args >> cmd >> arg1 >> arg2;
+
+    unsigned long value = 0;
+    unsigned long count = 0;
+
+    if (cmd == "c" || cmd == "continue") {
+        return true;
+    } else if (cmd == "s" || cmd == "step") {
+        steps = parseHex(arg1, count) && count ? count : 1;
+        return true;
+    } else if (cmd == "n" || cmd == "next") {
+        uint16_t opcode = (chip8.memory[chip8.pc & MEM_HI] << 8u) |
+                          chip8.memory[(chip8.pc + 1) & MEM_HI];
+
+        if (decode(opcode) == OP_2NNN) {
+            stepOver = true;
+            stepOverPc = chip8.pc + 2;
+            stepOverSp = chip8.sp;
+        } else {
+            steps = 1;
+        }
+
+        return true;
+    } else if ((cmd == "b" || cmd == "break") && parseHex(arg1, value)) {
+        addBreakpoint(value);
+    } else if ((cmd == "d" || cmd == "delete") && parseHex(arg1, value)) {
+        removeBreakpoint(value);
+    } else if (cmd == "b" || cmd == "break") {
+        for (size_t i = 0; i < MAX_MEM; ++i) {
+            if (breakpoints[i]) {
+                showCode(i, 1);
+            }
+        }
+    } else if (cmd == "w" || cmd == "watch") {
+        Watch watch{WATCH_I, 0, 0};
+
+        if (arg1 == "I") {
+            watch.kind = WATCH_I;
+        } else if (arg1.size() == 2 && arg1[0] == 'V' && parseHex(arg1.substr(1), value)) {
+            watch.kind = WATCH_REG;
+            watch.index = value;
+        } else if (parseHex(arg1, value)) {
+            watch.kind = WATCH_MEM;
+            watch.index = value & MEM_HI;
+        } else {
+            for (Watch const& w : watches) {
+                out << watchName(w) << " = 0x" << std::hex << watchValue(w) << std::dec << "\n";
+            }
+
+            return false;
+        }
+
+        watch.last = watchValue(watch);
+        watches.push_back(watch);
+    } else if (cmd == "dw") {
+        watches.clear();
+    } else if (cmd == "r" || cmd == "regs") {
+        showRegs();
+    } else if (cmd == "bt" || cmd == "stack") {
+        showStack();
+    } else if (cmd == "x") {
+        parseHex(arg1, value);
+        showMemory(value, parseHex(arg2, count) ? count : 0x10);
+    } else if (cmd == "l" || cmd == "list") {
+        showCode(parseHex(arg1, value) ? value : chip8.pc, parseHex(arg2, count) ? count : 8);
+    } else if (cmd == "q" || cmd == "quit") {
+        chip8.quit = true;
+        return true;
+    } else if (cmd == "h" || cmd == "help") {
+        help();
+    } else if (!cmd.empty()) {
+        out << "unknown command '" << cmd << "', type 'h' for help" << std::endl;
+    }
+
+    return false;
+}
+
+void Debugger::showRegs() const {
+    out << std::uppercase << std::hex << std::setfill('0')
+        << "pc=" << std::setw(3) << chip8.pc
+        << " I=" << std::setw(3) << chip8.I
+        << " sp=" << std::setw(2) << chip8.sp
+        << " DT=" << std::setw(2) << unsigned(chip8.delayTimer)
+        << " ST=" << std::setw(2) << unsigned(chip8.sndTimer) << "\n";
+
+    for (int i = 0; i < NUM_REGS; ++i) {
+        out << "V" << i << "=" << std::setw(2) << unsigned(chip8.V[i])
+            << (i % 8 == 7 ? "\n" : " ");
+    }
+
+    out << std::dec << std::setfill(' ') << std::flush;
+}
+
+void Debugger::showStack() const {
+    for (int i = std::min<int>(chip8.sp, STACK_SIZE) - 1; i >= 0; --i) {
+        out << "#" << i << " 0x" << std::uppercase << std::hex << std::setw(3)
+            << std::setfill('0') << unsigned(chip8.stack[i]) << std::dec
+            << std::setfill(' ') << "\n";
+    }
+
+    out << std::flush;
+}
+
+void Debugger::showMemory(uint16_t aAddress, unsigned int aLength) const {
+    out << std::uppercase << std::hex << std::setfill('0');
+
+    for (unsigned int i = 0; i < aLength; ++i) {
+        uint16_t address = (aAddress + i) & MEM_HI;
+
+        if (i % 16 == 0) {
+            out << (i ? "\n" : "") << "0x" << std::setw(3) << address << ":";
+        }
+
+        out << " " << std::setw(2) << unsigned(chip8.memory[address]);
+    }
+
+    out << std::dec << std::setfill(' ') << std::endl;
+}
+
+void Debugger::showCode(uint16_t aAddress, unsigned int aCount) const {
+    for (unsigned int i = 0; i < aCount; ++i) {
+        uint16_t address = (aAddress + 2 * i) & MEM_HI;
+        uint16_t opcode = (chip8.memory[address] << 8u) |
+                          chip8.memory[(address + 1) & MEM_HI];
+
+        out << (address == chip8.pc ? "=> " : "   ") << "0x" << std::uppercase
+            << std::hex << std::setw(3) << std::setfill('0') << address << ": "
+            << std::setw(4) << opcode << std::dec << std::setfill(' ') << "  "
+            << disassemble(opcode) << (breakpoints[address] ? "  *" : "") << "\n";
+    }
+
+    out << std::flush;
+}
+
+void Debugger::help() const {
+    out << "c                 continue\n"
+        << "s [N]             step N instructions\n"
+        << "n                 step over calls\n"
+        << "b [ADDR]          set a breakpoint, or list them\n"
+        << "d ADDR            delete a breakpoint\n"
+        << "w [ADDR|Vx|I]     watch a memory byte or register, or list watches\n"
+        << "dw                delete all watches\n"
+        << "r                 show registers\n"
+        << "bt                show the call stack\n"
+        << "x ADDR [N]        dump N bytes of memory\n"
+        << "l [ADDR] [N]      disassemble N instructions\n"
+        << "q                 quit\n"
+        << "Numbers are hex. Ctrl-C breaks into the debugger." << std::endl;
+}
+} // chip8 namespace
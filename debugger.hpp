@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <bitset>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+
+namespace chip8 {
+// Interactive debugger driven from a terminal (or any pair of streams), or by
+// a remote front end through a stop handler. Chip8::emulate() only calls into
+// the checked loop here while active() is true, so a session with no
+// breakpoints runs the plain interpreter loop.
+class Debugger final {
+    public:
+        // Called on the emulation thread whenever execution stops. Returning
+        // resumes execution with whatever step/breakpoint state it left behind
+        typedef std::function<void(char const* aReason)> StopHandler;
+
+        Debugger(Chip8& aChip8, std::istream& aIn = std::cin,
+                 std::ostream& aOut = std::cout);
+        Debugger(Chip8& aChip8, StopHandler aHandler);
+        ~Debugger();
+
+        bool active() const {
+            return numBreakpoints || !watches.empty() || pause || steps || stepOver ||
+                   interrupt.load(std::memory_order_relaxed);
+        }
+
+        // Execute up to aCycles instructions, stopping at breakpoints and
+        // watchpoints. Returns the count executed
+        unsigned int run(unsigned int aCycles);
+
+        void addBreakpoint(uint16_t aAddress);
+        void removeBreakpoint(uint16_t aAddress);
+        void clearBreakpoints();
+        bool hasBreakpoint(uint16_t aAddress) const { return breakpoints[aAddress & MEM_HI]; }
+
+        // Stop again after aCount instructions once execution resumes
+        void step(unsigned int aCount) { steps = aCount; }
+
+        // Ask the emulation loop to stop at the next instruction. Safe to call
+        // from a signal handler or another thread
+        void requestBreak() { interrupt.store(true, std::memory_order_relaxed); }
+
+    private:
+        enum WatchKind : uint8_t {
+            WATCH_MEM,
+            WATCH_REG,
+            WATCH_I
+        };
+
+        struct Watch {
+            WatchKind kind;
+            uint16_t index;
+            uint16_t last;
+        };
+
+        uint16_t watchValue(Watch const& aWatch) const;
+        std::string watchName(Watch const& aWatch) const;
+        bool checkWatches();
+
+        void stop(char const* aReason);
+
+        // Read and execute commands until one resumes execution
+        void prompt(char const* aReason);
+        bool command(std::string aLine);
+
+        void showRegs() const;
+        void showStack() const;
+        void showMemory(uint16_t aAddress, unsigned int aLength) const;
+        void showCode(uint16_t aAddress, unsigned int aCount) const;
+        void help() const;
+
+        Chip8& chip8;
+        std::istream& in;
+        std::ostream& out;
+        StopHandler handler;
+
+        std::bitset<MAX_MEM> breakpoints;
+        unsigned int numBreakpoints{};
+        std::vector<Watch> watches;
+
+        // Stop before the next instruction
+        bool pause{true};
+        char const* pauseReason{"stopped"};
+        // Remaining instructions to single step
+        unsigned int steps{};
+        // Stepping over a call: stop once it returns to stepOverPc
+        bool stepOver{};
+        uint16_t stepOverPc{};
+        uint16_t stepOverSp{};
+
+        std::atomic<bool> interrupt{false};
+};
+} // chip8 namespace
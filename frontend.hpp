@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+namespace chip8 {
+// What Chip8::emulate() presents frames to and reads keys from, so the core
+// builds without any windowing library. Gfx is the SDL implementation
+class Frontend {
+    public:
+        virtual ~Frontend() {}
+
+        // buffer holds one byte per pixel (0 = off, anything else = on)
+        virtual void update(uint8_t const* buffer) = 0;
+
+        // Refresh keys (MAX_KEYS bytes, 1 = down). Returns true to quit
+        virtual bool input(uint8_t* keys) = 0;
+};
+}
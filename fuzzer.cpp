@@ -0,0 +1,266 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "fuzzer.hpp"
+
+namespace chip8 {
+static uint8_t const buckets[256] = {
+    0, 1, 2, 4, 8, 8, 8, 8, 16, 16, 16, 16, 16, 16, 16, 16,
+    32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128,
+    128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128,
+    128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128,
+    128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128,
+    128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128,
+    128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128,
+    128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128,
+    128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128
+};
+
+Fuzzer::Fuzzer(std::string aROMName, std::string aOutDir)
+    : romName(aROMName)
+    , outDir(aOutDir)
+    , virgin(COVERAGE_SIZE) {
+}
+
+bool Fuzzer::merge(uint8_t* aTrace, uint8_t* aVirgin) {
+    bool found = false;
+
+    for (size_t i = 0; i < COVERAGE_SIZE; ++i) {
+        uint8_t bucket = buckets[aTrace[i]];
+
+        if (bucket & ~aVirgin[i]) {
+            aVirgin[i] |= bucket;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+bool Fuzzer::fresh(uint8_t const* aTrace, uint8_t const* aVirgin) {
+    for (size_t i = 0; i < COVERAGE_SIZE; ++i) {
+        if (buckets[aTrace[i]] & ~aVirgin[i]) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+size_t Fuzzer::mutate(std::vector<uint16_t>& aKeys, std::mt19937& aRandom) {
+    size_t first = aKeys.size();
+    unsigned int count = 1 + aRandom() % 4;
+
+    for (unsigned int n = 0; n < count; ++n) {
+        size_t start = aRandom() % aKeys.size();
+        size_t end = std::min(aKeys.size(), start + 1 + aRandom() % 60);
+        uint16_t key = 1u << (aRandom() % MAX_KEYS);
+
+        switch (aRandom() % 4) {
+            case 0:
+                // Hold one key
+                for (size_t i = start; i < end; ++i) aKeys[i] = key;
+                break;
+            case 1:
+                // Toggle one key
+                for (size_t i = start; i < end; ++i) aKeys[i] ^= key;
+                break;
+            case 2:
+                // Release everything
+                for (size_t i = start; i < end; ++i) aKeys[i] = 0;
+                break;
+            case 3: {
+                // Splice in frames from another corpus entry
+                std::shared_ptr<Input const> other;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    other = corpus[aRandom() % corpus.size()];
+                }
+
+                std::copy(other->keys.begin() + start, other->keys.begin() + end,
+                          aKeys.begin() + start);
+                break;
+            }
+        }
+
+        first = std::min(first, start);
+    }
+
+    return first;
+}
+
+void Fuzzer::crashed(std::vector<uint16_t> const& aKeys, Trap const& aTrap) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // One report per fault site
+        if (!crashes.insert({aTrap.kind, aTrap.pc}).second) {
+            return;
+        }
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "/crash-%d-%03x.keys", aTrap.kind, aTrap.pc);
+
+    KeyScript script;
+    script.seed = FUZZ_SEED;
+    script.keys = aKeys;
+    script.save(outDir + name);
+
+    std::cout << describe(aTrap) << ", input saved to " << outDir << name << std::endl;
+}
+
+void Fuzzer::work(double aSeconds, unsigned int aId) {
+    Chip8 machine(romName);
+    std::vector<uint8_t> trace(COVERAGE_SIZE);
+    std::vector<Chip8::Snapshot> scratch(FUZZ_FRAMES / FUZZ_CHECKPOINT + 1);
+    std::mt19937 random(aId);
+
+    // Never more than the shared map, so nothing new here means nothing new
+    std::vector<uint8_t> seen;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        seen = virgin;
+    }
+
+    machine.setCoverage(trace.data());
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(aSeconds);
+
+    while (std::chrono::steady_clock::now() < deadline) {
+        std::shared_ptr<Input const> parent;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            parent = corpus[random() % corpus.size()];
+        }
+
+        std::vector<uint16_t> keys = parent->keys;
+        size_t first = mutate(keys, random);
+
+        // Resume from the parent's last checkpoint before the mutation
+        size_t checkpoint = first / FUZZ_CHECKPOINT;
+        machine.restore(*parent->checkpoints[checkpoint]);
+        memset(trace.data(), 0, trace.size());
+
+        size_t frame = checkpoint * FUZZ_CHECKPOINT;
+
+        while (frame < keys.size() && !machine.lastTrap().kind) {
+            if (frame % FUZZ_CHECKPOINT == 0) {
+                machine.save(scratch[frame / FUZZ_CHECKPOINT]);
+            }
+
+            // Batch frames with the same input so idle waits can be skipped
+            size_t end = frame + 1;
+
+            while (end < keys.size() && keys[end] == keys[frame] && end % FUZZ_CHECKPOINT) {
+                ++end;
+            }
+
+            machine.setKeys(keys[frame]);
+            machine.runFrames(end - frame);
+            frame = end;
+        }
+
+        ++execs;
+        frames += keys.size() - checkpoint * FUZZ_CHECKPOINT;
+
+        if (machine.lastTrap().kind) {
+            crashed(keys, machine.lastTrap());
+            continue;
+        }
+
+        if (!fresh(trace.data(), seen.data())) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        bool found = merge(trace.data(), virgin.data());
+        seen = virgin;
+
+        if (found) {
+            auto child = std::make_shared<Input>();
+            child->keys = keys;
+            child->checkpoints.assign(parent->checkpoints.begin(),
+                                      parent->checkpoints.begin() + checkpoint);
+
+            for (size_t i = checkpoint; i < scratch.size() && i * FUZZ_CHECKPOINT < keys.size(); ++i) {
+                child->checkpoints.push_back(std::make_shared<Chip8::Snapshot>(scratch[i]));
+            }
+
+            corpus.push_back(child);
+        }
+    }
+}
+
+void Fuzzer::run(double aSeconds, unsigned int aThreads) {
+    // Seed corpus: no input at all, starting from the freshly loaded ROM
+    Chip8 machine(romName);
+    std::vector<uint8_t> trace(COVERAGE_SIZE);
+    machine.seed(FUZZ_SEED);
+    machine.setCoverage(trace.data());
+
+    auto seed = std::make_shared<Input>();
+    seed->keys.assign(FUZZ_FRAMES, 0);
+
+    for (size_t frame = 0; frame < FUZZ_FRAMES; frame += FUZZ_CHECKPOINT) {
+        auto snapshot = std::make_shared<Chip8::Snapshot>();
+        machine.save(*snapshot);
+        seed->checkpoints.push_back(snapshot);
+        machine.runFrames(FUZZ_CHECKPOINT);
+    }
+
+    merge(trace.data(), virgin.data());
+    corpus.push_back(seed);
+
+    if (machine.lastTrap().kind) {
+        crashed(seed->keys, machine.lastTrap());
+    }
+
+    std::vector<std::thread> workers;
+
+    for (unsigned int i = 0; i < aThreads; ++i) {
+        workers.emplace_back(&Fuzzer::work, this, aSeconds, i);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration<double>(aSeconds);
+
+    while (std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        size_t edges = 0;
+        size_t inputs = 0;
+        size_t faults = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            for (uint8_t v : virgin) {
+                edges += v != 0;
+            }
+
+            inputs = corpus.size();
+            faults = crashes.size();
+        }
+
+        std::cout << "execs " << execs << " (" << execs / elapsed << "/s, "
+                  << frames / elapsed << " frames/s), corpus " << inputs
+                  << ", edges " << edges << ", crashes " << faults << std::endl;
+    }
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+} // chip8 namespace
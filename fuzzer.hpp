@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+#include "keyscript.hpp"
+
+namespace chip8 {
+// Length of a fuzz input in frames, and how often a run keeps a snapshot
+// that mutated children can resume from
+#define FUZZ_FRAMES 600
+#define FUZZ_CHECKPOINT 60
+#define FUZZ_SEED 0x5EED
+
+// Coverage-guided fuzzer over per-frame key sequences. Each thread owns a
+// headless machine; a child input shares its parent's frames up to the first
+// mutation, so execution restores the parent's snapshot there instead of
+// rebooting. Inputs that reach new edges join the shared corpus, and inputs
+// that trap are written to the output directory as key scripts. Each thread
+// checks its traces against its own copy of the coverage seen so far and only
+// takes the shared lock once that copy says something is new.
+class Fuzzer final {
+    public:
+        Fuzzer(std::string aROMName, std::string aOutDir);
+
+        void run(double aSeconds, unsigned int aThreads);
+
+    private:
+        struct Input {
+            std::vector<uint16_t> keys;
+            // State before frame i * FUZZ_CHECKPOINT
+            std::vector<std::shared_ptr<Chip8::Snapshot const>> checkpoints;
+        };
+
+        void work(double aSeconds, unsigned int aId);
+
+        // Returns the first frame that differs from the parent
+        size_t mutate(std::vector<uint16_t>& aKeys, std::mt19937& aRandom);
+
+        // Fold hit counts into AFL style buckets and merge into virgin.
+        // Returns true if anything new was seen
+        static bool merge(uint8_t* aTrace, uint8_t* aVirgin);
+        // merge() without the merging
+        static bool fresh(uint8_t const* aTrace, uint8_t const* aVirgin);
+
+        void crashed(std::vector<uint16_t> const& aKeys, Trap const& aTrap);
+
+        std::string romName;
+        std::string outDir;
+
+        // Shared between threads
+        std::mutex mutex;
+        std::vector<std::shared_ptr<Input const>> corpus;
+        std::vector<uint8_t> virgin;
+        std::set<std::pair<uint8_t, uint16_t>> crashes;
+        std::atomic<uint64_t> execs{0};
+        std::atomic<uint64_t> frames{0};
+};
+} // chip8 namespace
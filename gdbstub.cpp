@@ -0,0 +1,580 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "gdbstub.hpp"
+
+namespace chip8 {
+#define GDB_NUM_REGS 21
+
+static char const* targetXml =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\"><feature name=\"org.chip8.core\">"
+    "<reg name=\"v0\" bitsize=\"8\"/><reg name=\"v1\" bitsize=\"8\"/>"
+    "<reg name=\"v2\" bitsize=\"8\"/><reg name=\"v3\" bitsize=\"8\"/>"
+    "<reg name=\"v4\" bitsize=\"8\"/><reg name=\"v5\" bitsize=\"8\"/>"
+    "<reg name=\"v6\" bitsize=\"8\"/><reg name=\"v7\" bitsize=\"8\"/>"
+    "<reg name=\"v8\" bitsize=\"8\"/><reg name=\"v9\" bitsize=\"8\"/>"
+    "<reg name=\"va\" bitsize=\"8\"/><reg name=\"vb\" bitsize=\"8\"/>"
+    "<reg name=\"vc\" bitsize=\"8\"/><reg name=\"vd\" bitsize=\"8\"/>"
+    "<reg name=\"ve\" bitsize=\"8\"/><reg name=\"vf\" bitsize=\"8\"/>"
+    "<reg name=\"i\" bitsize=\"16\" type=\"data_ptr\"/>"
+    "<reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>"
+    "<reg name=\"sp\" bitsize=\"16\"/>"
+    "<reg name=\"dt\" bitsize=\"8\"/><reg name=\"st\" bitsize=\"8\"/>"
+    "</feature></target>";
+
+static std::string toHex(uint32_t aValue, unsigned int aBytes) {
+    // Registers travel in target (little endian) byte order
+    std::string text;
+    char buf[3];
+
+    for (unsigned int i = 0; i < aBytes; ++i) {
+        snprintf(buf, sizeof(buf), "%02x", (aValue >> (8 * i)) & 0xFFu);
+        text += buf;
+    }
+
+    return text;
+}
+
+static int hexDigit(char aChar) {
+    if (aChar >= '0' && aChar <= '9') return aChar - '0';
+    if (aChar >= 'a' && aChar <= 'f') return aChar - 'a' + 10;
+    if (aChar >= 'A' && aChar <= 'F') return aChar - 'A' + 10;
+    return -1;
+}
+
+// aBytes bytes in target byte order starting at aText[aPos]. Fails on short
+// or non-hex input
+static bool fromHex(std::string const& aText, size_t aPos, unsigned int aBytes, uint32_t& aValue) {
+    if (aPos > aText.size() || aText.size() - aPos < 2 * aBytes) {
+        return false;
+    }
+
+    aValue = 0;
+
+    for (unsigned int i = 0; i < 2 * aBytes; ++i) {
+        int digit = hexDigit(aText[aPos + i]);
+
+        if (digit < 0) {
+            return false;
+        }
+
+        aValue |= uint32_t(digit) << (8 * (i / 2) + (i % 2 ? 0 : 4));
+    }
+
+    return true;
+}
+
+// A big endian hex number such as an address or length, all of aText
+static bool parseNumber(std::string const& aText, uint32_t& aValue) {
+    if (aText.empty() || aText.size() > 8) {
+        return false;
+    }
+
+    aValue = 0;
+
+    for (char c : aText) {
+        int digit = hexDigit(c);
+
+        if (digit < 0) {
+            return false;
+        }
+
+        aValue = aValue << 4 | digit;
+    }
+
+    return true;
+}
+
+// Split aText at each aSeparator into numbers, e.g. "addr,length"
+static bool parseNumbers(std::string const& aText, char aSeparator,
+                         uint32_t* aValues, unsigned int aCount) {
+    size_t start = 0;
+
+    for (unsigned int i = 0; i < aCount; ++i) {
+        size_t end = i + 1 < aCount ? aText.find(aSeparator, start) : aText.size();
+
+        if (end == std::string::npos || !parseNumber(aText.substr(start, end - start), aValues[i])) {
+            return false;
+        }
+
+        start = end + 1;
+    }
+
+    return true;
+}
+
+// Stop reply for a Debugger stop reason, with the signal closest to it
+static char const* stopReply(char const* aReason, Trap const& aFault) {
+    if (strcmp(aReason, "interrupted") == 0) {
+        return "S02";
+    }
+
+    if (strcmp(aReason, "trap") == 0) {
+        switch (aFault.kind) {
+            case TRAP_ILLEGAL_OPCODE:
+                return "S04";
+            case TRAP_STACK_OVERFLOW:
+            case TRAP_STACK_UNDERFLOW:
+            case TRAP_MEMORY_BOUNDS:
+                return "S0B";
+            case TRAP_NONE:
+                break;
+        }
+    }
+
+    return "S05";
+}
+
+static unsigned int regSize(unsigned int aReg) {
+    return (aReg >= 16 && aReg <= 18) ? 2 : 1;
+}
+
+GdbStub::GdbStub(Chip8& aChip8, int aPort)
+    : chip8(aChip8)
+    , debugger(aChip8, [this](char const* aReason) { halted(aReason); })
+    , port(aPort) {
+    server = socket(AF_INET, SOCK_STREAM, 0);
+
+    int yes = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (server < 0 || bind(server, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(server, 1) < 0) {
+        std::cerr << "Failed to listen for GDB on port " << port << std::endl;
+        return;
+    }
+
+    std::cout << "Waiting for GDB on localhost:" << port << std::endl;
+    thread = std::thread(&GdbStub::serve, this);
+}
+
+GdbStub::~GdbStub() {
+    shutdown = true;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = false;
+    }
+
+    cv.notify_all();
+
+    // Unblock accept()/recv() on the server thread
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (client >= 0) {
+            ::shutdown(client, SHUT_RDWR);
+        }
+    }
+
+    if (server >= 0) {
+        ::shutdown(server, SHUT_RDWR);
+        close(server);
+    }
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void GdbStub::halted(char const* aReason) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (shutdown) {
+        return;
+    }
+
+    // The client went away: drop its breakpoints here, where the core reads
+    // them, and let the game run on
+    if (client < 0) {
+        debugger.clearBreakpoints();
+        return;
+    }
+
+    stopped = true;
+    lastStop = stopReply(aReason, chip8.fault);
+
+    // Still under the lock, so serve() cannot close the socket meanwhile
+    if (running) {
+        running = false;
+        sendPacket(lastStop);
+    }
+
+    cv.notify_all();
+    cv.wait(lock, [this] { return !stopped || shutdown; });
+}
+
+void GdbStub::waitForStop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this] { return stopped || shutdown || chip8.quit; });
+}
+
+void GdbStub::resume(bool aStep, bool aReport) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (aStep) {
+        debugger.step(1);
+    }
+
+    running = aReport;
+    stopped = false;
+    cv.notify_all();
+}
+
+void GdbStub::serve() {
+    while (!shutdown) {
+        int fd = accept(server, nullptr, nullptr);
+
+        if (fd < 0) {
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            client = fd;
+        }
+
+        // The client expects a stopped target when it attaches
+        debugger.requestBreak();
+        waitForStop();
+
+        std::string packet;
+
+        while (!shutdown && readPacket(packet)) {
+            handle(packet);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            client = -1;
+            close(fd);
+        }
+
+        // The core clears the breakpoints at the stop this forces, then runs on
+        debugger.requestBreak();
+        resume(false, false);
+    }
+}
+
+bool GdbStub::readPacket(std::string& aPacket) {
+    char c;
+
+    while (true) {
+        // Skip acks and wait for the start of a packet; a bare 0x03 is a break
+        do {
+            if (recv(client, &c, 1, 0) != 1) {
+                return false;
+            }
+
+            if (c == 0x03) {
+                debugger.requestBreak();
+            }
+        } while (c != '$');
+
+        aPacket.clear();
+        uint8_t sum = 0;
+
+        while (true) {
+            if (recv(client, &c, 1, 0) != 1) {
+                return false;
+            }
+
+            if (c == '#') {
+                break;
+            }
+
+            aPacket += c;
+            sum += c;
+        }
+
+        std::string checksum(2, '\0');
+        uint32_t expected = 0;
+
+        if (recv(client, &checksum[0], 2, MSG_WAITALL) != 2) {
+            return false;
+        }
+
+        // Ask for a retransmission of anything that arrived damaged
+        bool intact = fromHex(checksum, 0, 1, expected) && expected == sum;
+
+        std::lock_guard<std::mutex> lock(sendMutex);
+        send(client, intact ? "+" : "-", 1, MSG_NOSIGNAL);
+
+        if (intact && !aPacket.empty()) {
+            return true;
+        }
+    }
+}
+
+void GdbStub::sendPacket(std::string const& aPacket) {
+    uint8_t sum = 0;
+
+    for (char c : aPacket) {
+        sum += c;
+    }
+
+    char checksum[4];
+    snprintf(checksum, sizeof(checksum), "#%02x", sum);
+
+    std::string frame = "$" + aPacket + checksum;
+    std::lock_guard<std::mutex> lock(sendMutex);
+    send(client, frame.data(), frame.size(), MSG_NOSIGNAL);
+}
+
+void GdbStub::handle(std::string const& aPacket) {
+    // All-stop mode: state is only touched while the core is parked
+    if (aPacket[0] != 'c' && aPacket[0] != 's' && aPacket.compare(0, 5, "vCont") != 0) {
+        waitForStop();
+    }
+
+    if (chip8.quit) {
+        sendPacket("W00");
+        return;
+    }
+
+    // Malformed requests are answered with E01 before anything is changed
+    uint32_t args[2] = {};
+    size_t split = 0;
+
+    switch (aPacket[0]) {
+        case '?': {
+            std::unique_lock<std::mutex> lock(mutex);
+            char const* reply = lastStop;
+            lock.unlock();
+            sendPacket(reply);
+            return;
+        }
+        case 'g':
+            sendPacket(readRegisters());
+            return;
+        case 'G': {
+            uint32_t values[GDB_NUM_REGS];
+            size_t pos = 1;
+
+            for (unsigned int reg = 0; reg < GDB_NUM_REGS; pos += 2 * regSize(reg), ++reg) {
+                if (!fromHex(aPacket, pos, regSize(reg), values[reg])) {
+                    sendPacket("E01");
+                    return;
+                }
+            }
+
+            for (unsigned int reg = 0; reg < GDB_NUM_REGS; ++reg) {
+                writeRegister(reg, values[reg]);
+            }
+
+            sendPacket("OK");
+            return;
+        }
+        case 'p':
+            if (parseNumber(aPacket.substr(1), args[0]) && args[0] < GDB_NUM_REGS) {
+                sendPacket(readRegister(args[0]));
+            } else {
+                sendPacket("E01");
+            }
+            return;
+        case 'P':
+            split = aPacket.find('=');
+
+            if (split != std::string::npos && parseNumber(aPacket.substr(1, split - 1), args[0]) &&
+                args[0] < GDB_NUM_REGS && aPacket.size() - split - 1 == 2 * regSize(args[0]) &&
+                fromHex(aPacket, split + 1, regSize(args[0]), args[1])) {
+                writeRegister(args[0], args[1]);
+                sendPacket("OK");
+            } else {
+                sendPacket("E01");
+            }
+            return;
+        case 'm': {
+            if (!parseNumbers(aPacket.substr(1), ',', args, 2)) {
+                sendPacket("E01");
+                return;
+            }
+
+            std::string reply;
+            uint8_t value;
+
+            for (uint32_t i = 0; i < args[1] && readByte(args[0] + i, value); ++i) {
+                reply += toHex(value, 1);
+            }
+
+            sendPacket(reply.empty() && args[1] ? "E01" : reply);
+            return;
+        }
+        case 'M': {
+            split = aPacket.find(':');
+
+            if (split == std::string::npos || !parseNumbers(aPacket.substr(1, split - 1), ',', args, 2) ||
+                aPacket.size() - split - 1 != 2 * size_t(args[1])) {
+                sendPacket("E01");
+                return;
+            }
+
+            std::vector<uint8_t> data(args[1]);
+            uint8_t current;
+
+            for (uint32_t i = 0; i < args[1]; ++i) {
+                uint32_t value = 0;
+
+                if (!fromHex(aPacket, split + 1 + 2 * i, 1, value) || !readByte(args[0] + i, current)) {
+                    sendPacket("E01");
+                    return;
+                }
+
+                data[i] = value;
+            }
+
+            for (uint32_t i = 0; i < args[1]; ++i) {
+                writeByte(args[0] + i, data[i]);
+            }
+
+            sendPacket("OK");
+            return;
+        }
+        case 'c':
+            resume(false);
+            return;
+        case 's':
+            resume(true);
+            return;
+        case 'Z':
+        case 'z':
+            // Software and hardware breakpoints are the same thing here;
+            // other kinds are unsupported
+            if (aPacket.size() < 2 || (aPacket[1] != '0' && aPacket[1] != '1')) {
+                sendPacket("");
+            } else if (aPacket.size() < 3 || aPacket[2] != ',' ||
+                       !parseNumbers(aPacket.substr(3), ',', args, 2)) {
+                sendPacket("E01");
+            } else {
+                if (aPacket[0] == 'Z') {
+                    debugger.addBreakpoint(args[0]);
+                } else {
+                    debugger.removeBreakpoint(args[0]);
+                }
+
+                sendPacket("OK");
+            }
+            return;
+        case 'k':
+            chip8.quit = true;
+            resume(false);
+            return;
+        case 'D':
+            sendPacket("OK");
+            debugger.clearBreakpoints();
+            resume(false, false);
+            return;
+        case 'H':
+        case 'T':
+            sendPacket("OK");
+            return;
+    }
+
+    if (aPacket.compare(0, 6, "vCont?") == 0) {
+        sendPacket("vCont;c;s");
+    } else if (aPacket.compare(0, 6, "vCont;") == 0) {
+        resume(aPacket[6] == 's');
+    } else if (aPacket.compare(0, 10, "qSupported") == 0) {
+        sendPacket("PacketSize=1000;qXfer:features:read+");
+    } else if (aPacket.compare(0, 31, "qXfer:features:read:target.xml:") == 0) {
+        if (!parseNumbers(aPacket.substr(31), ',', args, 2)) {
+            sendPacket("E01");
+            return;
+        }
+
+        std::string xml = targetXml;
+        std::string chunk = args[0] < xml.size() ? xml.substr(args[0], args[1]) : "";
+        sendPacket((args[0] + chunk.size() < xml.size() ? "m" : "l") + chunk);
+    } else if (aPacket == "qAttached") {
+        sendPacket("1");
+    } else if (aPacket == "qC") {
+        sendPacket("QC1");
+    } else if (aPacket == "qfThreadInfo") {
+        sendPacket("m1");
+    } else if (aPacket == "qsThreadInfo") {
+        sendPacket("l");
+    } else {
+        sendPacket("");
+    }
+}
+
+std::string GdbStub::readRegisters() const {
+    std::string text;
+
+    for (unsigned int reg = 0; reg < GDB_NUM_REGS; ++reg) {
+        text += readRegister(reg);
+    }
+
+    return text;
+}
+
+std::string GdbStub::readRegister(unsigned int aReg) const {
+    switch (aReg) {
+        case 16: return toHex(chip8.I, 2);
+        case 17: return toHex(chip8.pc, 2);
+        case 18: return toHex(chip8.sp, 2);
+        case 19: return toHex(chip8.delayTimer, 1);
+        case 20: return toHex(chip8.sndTimer, 1);
+        default: return toHex(chip8.V[aReg & 0xF], 1);
+    }
+}
+
+void GdbStub::writeRegister(unsigned int aReg, uint16_t aValue) {
+    switch (aReg) {
+        case 16: chip8.I = aValue; break;
+        case 17: chip8.pc = aValue; break;
+        case 18: chip8.sp = aValue; break;
+        case 19: chip8.delayTimer = aValue; break;
+        case 20: chip8.sndTimer = aValue; break;
+        default: chip8.V[aReg & 0xF] = aValue; break;
+    }
+}
+
+bool GdbStub::readByte(uint32_t aAddress, uint8_t& aValue) const {
+    if (aAddress < MAX_MEM) {
+        aValue = chip8.memory[aAddress];
+        return true;
+    }
+
+    uint32_t offset = aAddress - GDB_STACK_BASE;
+
+    if (aAddress >= GDB_STACK_BASE && offset < 2 * STACK_SIZE) {
+        aValue = (chip8.stack[offset / 2] >> (8 * (offset % 2))) & 0xFFu;
+        return true;
+    }
+
+    return false;
+}
+
+bool GdbStub::writeByte(uint32_t aAddress, uint8_t aValue) {
+    if (aAddress < MAX_MEM) {
+        chip8.memory[aAddress] = aValue;
+        chip8.invalidateNative(aAddress, 1);
+        return true;
+    }
+
+    uint32_t offset = aAddress - GDB_STACK_BASE;
+
+    if (aAddress >= GDB_STACK_BASE && offset < 2 * STACK_SIZE) {
+        unsigned int shift = 8 * (offset % 2);
+        chip8.stack[offset / 2] = (chip8.stack[offset / 2] & ~(0xFFu << shift)) | (aValue << shift);
+        return true;
+    }
+
+    return false;
+}
+} // chip8 namespace
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "chip8.hpp"
+#include "debugger.hpp"
+
+namespace chip8 {
+// Address at which the call stack is exposed to the client
+#define GDB_STACK_BASE 0x10000
+
+// GDB remote serial protocol server on 127.0.0.1. The socket is served from its
+// own thread; the emulation thread only sees the attached Debugger, which stays
+// on the unchecked fast path until a client connects or sends a break.
+//
+// Register numbers: 0-15 = V0-VF, 16 = I, 17 = pc, 18 = sp, 19 = DT, 20 = ST.
+// Addresses 0x000-0xFFF map to memory; the call stack is exposed read/write
+// at GDB_STACK_BASE as 16-bit little endian entries.
+class GdbStub final {
+    public:
+        GdbStub(Chip8& aChip8, int aPort);
+        ~GdbStub();
+
+    private:
+        // Emulation thread: park the core until the client resumes it. With no
+        // client it clears the breakpoints and returns at once
+        void halted(char const* aReason);
+
+        // Server thread
+        void serve();
+        bool readPacket(std::string& aPacket);
+        void sendPacket(std::string const& aPacket);
+        void handle(std::string const& aPacket);
+        void waitForStop();
+        // aReport: send a stop reply when the core halts again
+        void resume(bool aStep, bool aReport = true);
+
+        std::string readRegisters() const;
+        std::string readRegister(unsigned int aReg) const;
+        void writeRegister(unsigned int aReg, uint16_t aValue);
+        bool readByte(uint32_t aAddress, uint8_t& aValue) const;
+        bool writeByte(uint32_t aAddress, uint8_t aValue);
+
+        Chip8& chip8;
+        Debugger debugger;
+        int port;
+        int server{-1};
+        // Set and closed by the server thread under mutex; the emulation
+        // thread only uses it with mutex held
+        int client{-1};
+
+        // Guards the run state below
+        std::mutex mutex;
+        // Serialises writes to the client socket
+        std::mutex sendMutex;
+        std::condition_variable cv;
+        bool stopped{};
+        // A resume was sent; the next stop must be reported to the client
+        bool running{};
+        // Stop reply for the current stop, also the answer to '?'
+        char const* lastStop{"S05"};
+
+        std::atomic<bool> shutdown{false};
+        std::thread thread;
+};
+} // chip8 namespace
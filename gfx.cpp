@@ -1,10 +1,48 @@
 #include "gfx.hpp"
 
 namespace chip8 {
-    void Gfx::update(void const* buffer, int pitch) {
-        SDL_UpdateTexture(texture, nullptr, buffer, pitch);
-		SDL_RenderClear(renderer);
-		SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+    void Gfx::update(uint8_t const* buffer) {
+        // Collapse each row into runs of lit pixels. CHIP-8 screens are sparse so
+        // this is far less data than uploading a full RGBA texture every frame
+        int count = 0;
+
+        for (int y = 0; y < textureHeight; ++y) {
+            uint8_t const* row = buffer + y * textureWidth;
+
+            for (int x = 0; x < textureWidth; ++x) {
+                if (row[x]) {
+                    int start = x;
+
+                    while (x < textureWidth && row[x]) {
+                        ++x;
+                    }
+
+                    rects[count++] = SDL_Rect{start, y, x - start, 1};
+                }
+            }
+        }
+
+        if (phosphor) {
+            // Fade what is already on the phosphor, then light the new frame
+            SDL_SetRenderTarget(renderer, phosphor);
+            SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xFF - persistence);
+            SDL_RenderFillRect(renderer, nullptr);
+            SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+            SDL_RenderFillRects(renderer, rects.data(), count);
+            SDL_SetRenderTarget(renderer, nullptr);
+
+            // The copy does not cover the letterbox borders
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xFF);
+            SDL_RenderClear(renderer);
+            SDL_RenderCopy(renderer, phosphor, nullptr, nullptr);
+        } else {
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xFF);
+            SDL_RenderClear(renderer);
+            SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+            SDL_RenderFillRects(renderer, rects.data(), count);
+        }
+
 		SDL_RenderPresent(renderer);
     }
 
@@ -165,7 +203,10 @@ namespace chip8 {
     }
 
     Gfx::~Gfx() {
-        SDL_DestroyTexture(texture);
+        if (phosphor) {
+            SDL_DestroyTexture(phosphor);
+        }
+
         SDL_DestroyRenderer(renderer);
         SDL_DestroyWindow(window);
         SDL_Quit();
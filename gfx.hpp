@@ -1,30 +1,54 @@
 #include <bits/stdint-uintn.h>
+#include <vector>
 
 #include <SDL2/SDL.h> 
 
+#include "frontend.hpp"
+
 namespace chip8 {
 // Handle all SDL related things
-class Gfx {
+class Gfx : public Frontend {
     public:
+        // aPersistence controls how much of the previous frame survives each
+        // update (0 = none, 255 = never fades). Blending the old frame in hides
+        // the flicker caused by games that erase and redraw sprites every frame
         Gfx(char const* title, int windowWidth, int windowHeight,
-            int textureWidth, int textureHeight)
+            int textureWidth, int textureHeight, uint8_t aPersistence = 0xA0)
         : title(title)
         , windowWidth(windowWidth)
         , windowHeight(windowHeight)
-        , textureWidth(textureWidth) {
+        , textureWidth(textureWidth)
+        , textureHeight(textureHeight)
+        , persistence(aPersistence)
+        , rects(textureWidth * textureHeight / 2 + textureHeight) {
             // Initialize SDL gfx
             SDL_Init(SDL_INIT_VIDEO);
 
             window = SDL_CreateWindow(title, 0, 0, windowWidth, windowHeight,
                                         SDL_WINDOW_SHOWN);
             renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-            texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
-                                        SDL_TEXTUREACCESS_STREAMING, textureWidth,
-                                        textureHeight);
+
+            // Let the renderer scale the CHIP-8 resolution up to the window so
+            // only the 64x32 image ever leaves the CPU
+            SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
+            SDL_RenderSetLogicalSize(renderer, textureWidth, textureHeight);
+            SDL_RenderSetIntegerScale(renderer, SDL_TRUE);
+
+            // Phosphor texture accumulates decaying frames on the GPU side
+            if (persistence && SDL_RenderTargetSupported(renderer)) {
+                phosphor = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+                                             SDL_TEXTUREACCESS_TARGET, textureWidth,
+                                             textureHeight);
+                SDL_SetRenderTarget(renderer, phosphor);
+                SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xFF);
+                SDL_RenderClear(renderer);
+                SDL_SetRenderTarget(renderer, nullptr);
+            }
         }
 
-        void update(void const* buffer, int pitch);
-        bool input(uint8_t* keys);
+        // buffer holds one byte per pixel (0 = off, anything else = on)
+        void update(uint8_t const* buffer) override;
+        bool input(uint8_t* keys) override;
         ~Gfx();
     
     private:
@@ -33,9 +57,13 @@ class Gfx {
         int windowHeight;
         int textureWidth;
         int textureHeight;
+        uint8_t persistence;
+
+        // Lit pixels are submitted as horizontal runs and filled by the GPU
+        std::vector<SDL_Rect> rects;
 
         SDL_Window* window{};
         SDL_Renderer* renderer{};
-        SDL_Texture* texture{};
+        SDL_Texture* phosphor{};
 };
-}
\ No newline at end of file
+}
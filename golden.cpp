@@ -0,0 +1,261 @@
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "golden.hpp"
+#include "op.hpp"
+
+namespace chip8 {
+// All of aText (trailing blanks aside) as a number no larger than aMax
+static bool parseNumber(std::string const& aText, int aBase, unsigned long long aMax,
+                        unsigned long long& aValue) {
+    char const* text = aText.c_str();
+    char* end;
+
+    errno = 0;
+    aValue = strtoull(text, &end, aBase);
+
+    while (isspace((unsigned char)*end)) {
+        ++end;
+    }
+
+    return end != text && !*end && !errno && aValue <= aMax;
+}
+
+static std::string describeDraw(DrawRecord const& aDraw) {
+    char text[64];
+    snprintf(text, sizeof(text), "pc=0x%03X opcode=0x%04X hash=%016llx",
+             aDraw.pc, aDraw.opcode, (unsigned long long)aDraw.hash);
+    return text;
+}
+
+void Golden::record(Chip8& aChip8, KeyScript const& aScript) {
+    seed = aScript.seed;
+    frames.clear();
+    frames.reserve(aScript.keys.size());
+
+    aChip8.seed(seed);
+
+    std::vector<DrawRecord> draws;
+    aChip8.setDrawLog(&draws);
+
+    for (uint16_t keys : aScript.keys) {
+        draws.clear();
+        aChip8.setKeys(keys);
+        aChip8.runFrames(1);
+        frames.push_back(Frame{aChip8.state().gfxHash, draws});
+    }
+
+    aChip8.setDrawLog(nullptr);
+}
+
+bool Golden::load(std::string aPath) {
+    std::ifstream in(aPath);
+
+    if (!in.is_open()) {
+        return false;
+    }
+
+    frames.clear();
+    std::string line;
+
+    auto malformed = [&](unsigned int aNumber) {
+        std::cerr << aPath << ":" << aNumber << ": malformed line" << std::endl;
+        return false;
+    };
+
+    for (unsigned int number = 1; std::getline(in, line); ++number) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        unsigned long long value;
+
+        if (line.compare(0, 5, "seed ") == 0) {
+            if (!parseNumber(line.substr(5), 10, UINT32_MAX, value)) {
+                return malformed(number);
+            }
+
+            seed = value;
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::string field;
+        Frame frame{};
+
+        if (!(fields >> field) || !parseNumber(field, 16, UINT64_MAX, value)) {
+            return malformed(number);
+        }
+
+        frame.hash = value;
+
+        while (fields >> field) {
+            unsigned int pc;
+            unsigned int opcode;
+            unsigned long long hash;
+            int length = 0;
+
+            if (sscanf(field.c_str(), "%x:%x:%llx%n", &pc, &opcode, &hash, &length) != 3 ||
+                size_t(length) != field.size() || pc > MEM_HI || opcode > 0xFFFF) {
+                return malformed(number);
+            }
+
+            frame.draws.push_back(DrawRecord{uint16_t(pc), uint16_t(opcode), hash});
+        }
+
+        frames.push_back(frame);
+    }
+
+    return true;
+}
+
+bool Golden::save(std::string aPath) const {
+    std::ofstream out(aPath);
+
+    if (!out.is_open()) {
+        return false;
+    }
+
+    out << "seed " << seed << "\n";
+
+    char text[48];
+
+    for (Frame const& frame : frames) {
+        snprintf(text, sizeof(text), "%016llx", (unsigned long long)frame.hash);
+        out << text;
+
+        for (DrawRecord const& draw : frame.draws) {
+            snprintf(text, sizeof(text), " %03x:%04x:%016llx", draw.pc, draw.opcode,
+                     (unsigned long long)draw.hash);
+            out << text;
+        }
+
+        out << "\n";
+    }
+
+    return bool(out);
+}
+
+static bool sameDraw(DrawRecord const& aExpected, DrawRecord const& aActual) {
+    return aExpected.pc == aActual.pc && aExpected.opcode == aActual.opcode &&
+           aExpected.hash == aActual.hash;
+}
+
+bool Golden::compare(Golden const& aActual, std::ostream& aOut, size_t* aFrame) const {
+    // Cxkk would differ from the first random number on, which is no regression
+    if (seed != aActual.seed) {
+        aOut << "run uses seed " << aActual.seed << " but the golden was recorded with seed "
+             << seed << "\n";
+        return false;
+    }
+
+    size_t count = std::min(frames.size(), aActual.frames.size());
+
+    for (size_t i = 0; i < count; ++i) {
+        Frame const& expected = frames[i];
+        Frame const& actual = aActual.frames[i];
+
+        // The screen hash settles almost every frame; draws are only looked
+        // at once it disagrees
+        if (expected.hash == actual.hash) {
+            continue;
+        }
+
+        char hashes[80];
+        snprintf(hashes, sizeof(hashes), "screen hash %016llx, expected %016llx",
+                 (unsigned long long)actual.hash, (unsigned long long)expected.hash);
+        aOut << "frame " << i << ": " << hashes << "\n";
+
+        if (aFrame) {
+            *aFrame = i;
+        }
+
+        size_t draws = std::min(expected.draws.size(), actual.draws.size());
+
+        for (size_t d = 0; d < draws; ++d) {
+            DrawRecord const& want = expected.draws[d];
+            DrawRecord const& got = actual.draws[d];
+
+            if (!sameDraw(want, got)) {
+                aOut << "  first differing draw #" << d << ": " << describeDraw(got)
+                     << "\n  expected: " << describeDraw(want) << "\n";
+                return false;
+            }
+        }
+
+        if (expected.draws.size() > draws) {
+            aOut << "  missing draw #" << draws << ": " << describeDraw(expected.draws[draws]) << "\n";
+        } else if (actual.draws.size() > draws) {
+            aOut << "  unexpected draw #" << draws << ": " << describeDraw(actual.draws[draws]) << "\n";
+        } else {
+            // Same draws but a different picture: the screen differed before
+            // this frame without any draw to show for it
+            aOut << "  draws match; screen state diverged outside 00E0/Dxyn\n";
+        }
+
+        return false;
+    }
+
+    if (frames.size() != aActual.frames.size()) {
+        aOut << "ran " << aActual.frames.size() << " frames, expected " << frames.size() << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+void Golden::locate(Chip8& aChip8, KeyScript const& aScript, size_t aFrame,
+                    std::ostream& aOut) const {
+    aChip8.seed(aScript.seed);
+
+    for (size_t f = 0; f < aFrame; ++f) {
+        aChip8.setKeys(aScript.keys[f]);
+        aChip8.runFrames(1);
+    }
+
+    std::vector<DrawRecord> const& expected = frames[aFrame].draws;
+    std::vector<DrawRecord> draws;
+    char line[32];
+
+    aChip8.setKeys(aScript.keys[aFrame]);
+    aChip8.setDrawLog(&draws);
+    aOut << "  frame " << aFrame << " replayed:\n";
+
+    // frame() one instruction at a time, through the same core the run used
+    if (aChip8.beginFrame()) {
+        for (unsigned int i = 0; i < CYCLES_PER_FRAME && !aChip8.yield; ++i) {
+            uint16_t pc = aChip8.pc & MEM_HI;
+            uint16_t opcode = aChip8.memory[pc] << 8 | aChip8.memory[(pc + 1) & MEM_HI];
+            size_t drawn = draws.size();
+
+            aChip8.step(1);
+
+            snprintf(line, sizeof(line), "    0x%03X  %04X  ", pc, opcode);
+            aOut << line << disassemble(opcode);
+
+            if (draws.size() > drawn &&
+                (drawn >= expected.size() || !sameDraw(expected[drawn], draws[drawn]))) {
+                aOut << "  <-- first instruction to depart from the golden\n";
+                aChip8.setDrawLog(nullptr);
+                return;
+            }
+
+            aOut << "\n";
+        }
+    }
+
+    aChip8.setDrawLog(nullptr);
+
+    if (draws.size() < expected.size()) {
+        aOut << "  the frame ended before draw #" << draws.size() << " at pc=0x" << std::hex
+             << expected[draws.size()].pc << std::dec << "\n";
+    } else {
+        aOut << "  every instruction drew as recorded; the screen differed entering the frame\n";
+    }
+}
+} // chip8 namespace
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+#include "keyscript.hpp"
+
+namespace chip8 {
+// Expected behaviour of a ROM under scripted input: the screen hash after
+// every frame and the draw instructions that produced it. Stored as text:
+// an optional "seed N" line, then one line per frame holding the hash and
+// pc:opcode:hash for each draw in that frame.
+struct Golden {
+    struct Frame {
+        uint64_t hash;
+        std::vector<DrawRecord> draws;
+    };
+
+    uint32_t seed{};
+    std::vector<Frame> frames;
+
+    // Run aScript on a freshly loaded machine, one frame at a time
+    void record(Chip8& aChip8, KeyScript const& aScript);
+
+    bool load(std::string aPath);
+    bool save(std::string aPath) const;
+
+    // Report the first frame where aActual departs from this and the first
+    // draw instruction in it that differs, setting aFrame to that frame if
+    // given. Runs recorded with another seed are refused outright. Returns
+    // true if they match
+    bool compare(Golden const& aActual, std::ostream& aOut, size_t* aFrame = nullptr) const;
+
+    // Replay aScript on a freshly loaded aChip8 up to frame aFrame, then run
+    // that frame one instruction at a time, listing each up to the first one
+    // whose draw departs from this golden
+    void locate(Chip8& aChip8, KeyScript const& aScript, size_t aFrame, std::ostream& aOut) const;
+};
+} // chip8 namespace
@@ -0,0 +1,80 @@
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "keyscript.hpp"
+
+namespace chip8 {
+// All of aText (trailing blanks aside) as a number no larger than aMax
+static bool parseNumber(std::string const& aText, int aBase, unsigned long aMax,
+                        unsigned long& aValue) {
+    char const* text = aText.c_str();
+    char* end;
+
+    errno = 0;
+    aValue = strtoul(text, &end, aBase);
+
+    while (isspace((unsigned char)*end)) {
+        ++end;
+    }
+
+    return end != text && !*end && !errno && aValue <= aMax;
+}
+
+bool KeyScript::load(std::string aPath) {
+    std::ifstream in(aPath);
+
+    if (!in.is_open()) {
+        return false;
+    }
+
+    keys.clear();
+    std::string line;
+    unsigned long value;
+
+    for (unsigned int number = 1; std::getline(in, line); ++number) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        bool valid;
+
+        if (line.compare(0, 5, "seed ") == 0) {
+            valid = parseNumber(line.substr(5), 10, UINT32_MAX, value);
+            seed = value;
+        } else {
+            valid = parseNumber(line, 16, UINT16_MAX, value);
+            keys.push_back(value);
+        }
+
+        if (!valid) {
+            std::cerr << aPath << ":" << number << ": malformed line" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool KeyScript::save(std::string aPath) const {
+    std::ofstream out(aPath);
+
+    if (!out.is_open()) {
+        return false;
+    }
+
+    out << "seed " << seed << "\n";
+
+    char line[8];
+
+    for (uint16_t mask : keys) {
+        snprintf(line, sizeof(line), "%04x\n", mask);
+        out << line;
+    }
+
+    return bool(out);
+}
+} // chip8 namespace
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace chip8 {
+// Scripted input: one 16-bit key mask per frame (bit n = key n down). Stored
+// as text, one hex mask per line, with an optional "seed N" line for Cxkk
+struct KeyScript {
+    uint32_t seed{};
+    std::vector<uint16_t> keys;
+
+    bool load(std::string aPath);
+    bool save(std::string aPath) const;
+};
+} // chip8 namespace
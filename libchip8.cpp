@@ -0,0 +1,293 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "chip8.hpp"
+#include "libchip8.h"
+
+// Machines per chunk of the instance pool
+#define ENV_POOL_CHUNK 64
+
+struct chip8_env {
+    chip8::Chip8 machine;
+    // State right after the ROM was loaded, shared with clones
+    std::shared_ptr<chip8::State const> initial;
+
+    chip8_env(char const* aROMName)
+        : machine(aROMName) {
+        std::shared_ptr<chip8::State> state(new chip8::State);
+        machine.save(*state);
+        initial = state;
+    }
+
+    // Instances come from a pool so workloads that clone thousands of
+    // machines stay out of the general purpose allocator
+    static void* operator new(size_t aSize);
+    static void operator delete(void* aEnv, size_t aSize);
+};
+
+namespace {
+// Fixed size slots carved out of large chunks and recycled through a free
+// list. Chunks are kept until exit
+class EnvPool final {
+    public:
+        void* allocate() {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (!freeList) {
+                grow();
+            }
+
+            Slot* slot = freeList;
+            freeList = slot->next;
+            return slot;
+        }
+
+        void release(void* aEnv) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            Slot* slot = static_cast<Slot*>(aEnv);
+            slot->next = freeList;
+            freeList = slot;
+        }
+
+    private:
+        union Slot {
+            Slot* next;
+            alignas(chip8_env) unsigned char storage[sizeof(chip8_env)];
+        };
+
+        void grow() {
+            chunks.emplace_back(new Slot[ENV_POOL_CHUNK]);
+            Slot* chunk = chunks.back().get();
+
+            for (size_t i = 0; i < ENV_POOL_CHUNK; ++i) {
+                chunk[i].next = freeList;
+                freeList = &chunk[i];
+            }
+        }
+
+        std::mutex mutex;
+        Slot* freeList{};
+        std::vector<std::unique_ptr<Slot[]>> chunks;
+};
+
+EnvPool envPool;
+
+// Persistent workers for chip8_step_batch. A batch is published by bumping
+// the generation; workers and the caller then claim machines from a shared
+// counter until none are left. The counter carries the generation in its top
+// half, so a worker that wakes late can never claim from a newer batch
+class BatchPool final {
+    public:
+        ~BatchPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+                ++generation;
+            }
+
+            start.notify_all();
+
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+        }
+
+        void resize(unsigned int aThreads) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            // The caller takes part in every batch, so spawn one fewer
+            while (workers.size() + 1 < aThreads) {
+                workers.emplace_back(&BatchPool::work, this);
+            }
+        }
+
+        void run(chip8_t* const* aEnvs, size_t aCount, unsigned int aFrames,
+                 uint16_t const* aKeys, uint8_t* aObservations, int* aStatus) {
+            // One batch at a time; the next caller waits for this one to finish
+            std::lock_guard<std::mutex> serial(callMutex);
+            std::unique_lock<std::mutex> lock(mutex);
+
+            if (workers.empty()) {
+                lock.unlock();
+                resize(std::max(1u, std::thread::hardware_concurrency()));
+                lock.lock();
+            }
+
+            batch = Batch{aEnvs, aCount, aFrames, aKeys, aObservations, aStatus};
+            done = 0;
+            uint32_t current = ++generation;
+            next.store(uint64_t(current) << 32, std::memory_order_relaxed);
+            lock.unlock();
+
+            start.notify_all();
+            drain(current, batch);
+
+            lock.lock();
+            finished.wait(lock, [this] { return done == batch.count; });
+        }
+
+    private:
+        struct Batch {
+            chip8_t* const* envs;
+            size_t count;
+            unsigned int frames;
+            uint16_t const* keys;
+            uint8_t* observations;
+            int* status;
+        };
+
+        void work() {
+            uint32_t seen = 0;
+
+            while (true) {
+                Batch current;
+
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    start.wait(lock, [&] { return generation != seen; });
+                    seen = generation;
+
+                    if (stopping) {
+                        return;
+                    }
+
+                    current = batch;
+                }
+
+                drain(seen, current);
+            }
+        }
+
+        // Step machines of batch aGeneration until none are left to claim
+        void drain(uint32_t aGeneration, Batch const& aBatch) {
+            size_t completed = 0;
+            uint64_t claim = next.load(std::memory_order_relaxed);
+
+            while (claim >> 32 == aGeneration && (claim & 0xFFFFFFFFu) < aBatch.count) {
+                if (!next.compare_exchange_weak(claim, claim + 1, std::memory_order_relaxed)) {
+                    continue;
+                }
+
+                size_t i = claim & 0xFFFFFFFFu;
+                chip8_t* env = aBatch.envs[i];
+
+                if (aBatch.keys) {
+                    env->machine.setKeys(aBatch.keys[i]);
+                }
+
+                int result = chip8_step(env, aBatch.frames);
+
+                if (aBatch.observations) {
+                    memcpy(aBatch.observations + i * CHIP8_FRAME_BYTES,
+                           env->machine.framebuffer(), CHIP8_FRAME_BYTES);
+                }
+
+                if (aBatch.status) {
+                    aBatch.status[i] = result;
+                }
+
+                ++completed;
+                claim = next.load(std::memory_order_relaxed);
+            }
+
+            // The batch cannot finish while this thread holds claims in it,
+            // so the generation is still current here
+            if (completed) {
+                std::lock_guard<std::mutex> lock(mutex);
+                done += completed;
+
+                if (done == batch.count) {
+                    finished.notify_one();
+                }
+            }
+        }
+
+        std::vector<std::thread> workers;
+        // Held by run() for a whole batch
+        std::mutex callMutex;
+        std::mutex mutex;
+        std::condition_variable start;
+        std::condition_variable finished;
+        uint32_t generation{};
+        bool stopping{};
+
+        // Current batch, published under the mutex
+        Batch batch{};
+        // Generation << 32 | next index to claim
+        std::atomic<uint64_t> next{};
+        size_t done{};
+};
+
+BatchPool pool;
+}
+
+// Pool slots fit exactly one chip8_env; anything else goes to the heap
+void* chip8_env::operator new(size_t aSize) {
+    return aSize == sizeof(chip8_env) ? envPool.allocate() : ::operator new(aSize);
+}
+
+void chip8_env::operator delete(void* aEnv, size_t aSize) {
+    if (aSize == sizeof(chip8_env)) {
+        envPool.release(aEnv);
+    } else {
+        ::operator delete(aEnv);
+    }
+}
+
+extern "C" {
+chip8_t* chip8_create(char const* rom_path) {
+    // Chip8 reports a bad ROM by exiting, so check it up front
+    std::ifstream rom(rom_path ? rom_path : "", std::ios::binary | std::ios::ate);
+
+    if (!rom.is_open() || rom.tellg() > MEM_HI - MEM_LO) {
+        return nullptr;
+    }
+
+    return new chip8_t(rom_path);
+}
+
+void chip8_destroy(chip8_t* env) {
+    delete env;
+}
+
+chip8_t* chip8_clone(chip8_t const* env) {
+    return new chip8_t(*env);
+}
+
+void chip8_reset(chip8_t* env) {
+    env->machine.restore(*env->initial);
+}
+
+void chip8_seed(chip8_t* env, uint32_t seed) {
+    env->machine.seed(seed);
+}
+
+void chip8_set_keys(chip8_t* env, uint16_t keys) {
+    env->machine.setKeys(keys);
+}
+
+int chip8_step(chip8_t* env, unsigned int frames) {
+    env->machine.runFrames(frames);
+    return env->machine.lastTrap().kind;
+}
+
+uint8_t const* chip8_framebuffer(chip8_t const* env) {
+    return env->machine.framebuffer();
+}
+
+void chip8_step_batch(chip8_t* const* envs, size_t count, unsigned int frames,
+                      uint16_t const* keys, uint8_t* observations, int* status) {
+    pool.run(envs, count, frames, keys, observations, status);
+}
+
+void chip8_set_threads(unsigned int threads) {
+    pool.resize(threads);
+}
+}
@@ -0,0 +1,64 @@
+#ifndef LIBCHIP8_H
+#define LIBCHIP8_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Stable C interface over the CHIP-8 core for embedding, e.g. in training
+ * loops. Instances never open a window and the library does not link SDL.
+ * Build with compile.sh, which also produces libchip8.so. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHIP8_WIDTH 64
+#define CHIP8_HEIGHT 32
+/* One byte per pixel, 0 or 1, row major */
+#define CHIP8_FRAME_BYTES (CHIP8_WIDTH * CHIP8_HEIGHT)
+
+typedef struct chip8_env chip8_t;
+
+/* Returns NULL if the ROM cannot be read or does not fit in memory */
+chip8_t* chip8_create(char const* rom_path);
+void chip8_destroy(chip8_t* env);
+
+/* Independent copy of a running machine. Copies the machine state only, so
+ * it is cheap enough to fork at every step of a search */
+chip8_t* chip8_clone(chip8_t const* env);
+
+/* Back to the state right after the ROM was loaded */
+void chip8_reset(chip8_t* env);
+
+/* Seed the generator behind Cxkk, which is otherwise seeded from the clock
+ * when the ROM is loaded. The same seed and keys replay the same run. Reset
+ * returns to the load time seed; clones carry on from their source's state */
+void chip8_seed(chip8_t* env, uint32_t seed);
+
+/* Bit n set = key n held down */
+void chip8_set_keys(chip8_t* env, uint16_t keys);
+
+/* Emulate frames at 60 Hz timing. Returns 0, or the trap kind (>0) once the
+ * machine has faulted; a faulted machine does not advance until reset */
+int chip8_step(chip8_t* env, unsigned int frames);
+
+/* Points into the machine; valid until the next call that advances it */
+uint8_t const* chip8_framebuffer(chip8_t const* env);
+
+/* Advance count machines by frames each on worker threads. keys (optional)
+ * holds one key mask per machine, applied before stepping. Observations are
+ * written to observations + i * CHIP8_FRAME_BYTES and per-machine results to
+ * status (optional). Nothing is allocated per call. The workers are shared,
+ * so batches from several threads run one after another, never together */
+void chip8_step_batch(chip8_t* const* envs, size_t count, unsigned int frames,
+                      uint16_t const* keys, uint8_t* observations, int* status);
+
+/* Worker threads used by chip8_step_batch, defaults to the hardware
+ * concurrency. Call before the first batch */
+void chip8_set_threads(unsigned int threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,297 @@
+#include <cstdio>
+#include <cstring>
+
+#include "lockstep.hpp"
+#include "op.hpp"
+
+namespace chip8 {
+// Memory differences listed before the rest are summarised
+#define LOCKSTEP_MEMORY_DIFFS 8
+
+Lockstep::Lockstep(Chip8& aReference, Chip8& aCandidate, std::ostream& aOut)
+    : reference(aReference)
+    , candidate(aCandidate)
+    , out(aOut) {
+}
+
+bool Lockstep::run(KeyScript const& aScript, unsigned int aInterval) {
+    reference.seed(aScript.seed);
+    candidate.seed(aScript.seed);
+
+    if (diff(nullptr)) {
+        out << "machines differ before the first instruction" << std::endl;
+        diff(&out);
+        return false;
+    }
+
+    if (!aInterval) {
+        for (uint64_t f = 0; f < aScript.keys.size(); ++f) {
+            reference.setKeys(aScript.keys[f]);
+            candidate.setKeys(aScript.keys[f]);
+
+            if (!stepFrame(f)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Last point where the hashes agreed
+    uint64_t mark = 0;
+    Chip8::Snapshot referenceCheckpoint = reference.state();
+    std::unique_ptr<Chip8> candidateCheckpoint = candidate.clone();
+
+    for (uint64_t f = 0; f < aScript.keys.size(); ++f) {
+        reference.setKeys(aScript.keys[f]);
+        candidate.setKeys(aScript.keys[f]);
+        reference.frame();
+        candidate.frame();
+
+        if ((f + 1) % aInterval && f + 1 != aScript.keys.size()) {
+            continue;
+        }
+
+        ++comparisonCount;
+
+        if (reference.stateHash() == candidate.stateHash()) {
+            mark = f + 1;
+            referenceCheckpoint = reference.state();
+            candidateCheckpoint = candidate.clone();
+            continue;
+        }
+
+        // Rewind, including whatever compiled blocks the candidate had then
+        reference.restore(referenceCheckpoint);
+        candidate.restore(candidateCheckpoint->state());
+        candidate.native = candidateCheckpoint->native;
+
+        for (uint64_t g = mark; g <= f; ++g) {
+            reference.setKeys(aScript.keys[g]);
+            candidate.setKeys(aScript.keys[g]);
+
+            if (!stepFrame(g)) {
+                return false;
+            }
+        }
+
+        // Only reachable if the hashes disagree about equal states
+        out << "state hashes differ at frame " << f << " but every field matches" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Chip8::frame() with the candidate's steps interleaved with the same number
+// of reference instructions. The pieces are the ones frame() is built from
+bool Lockstep::stepFrame(uint64_t aFrame) {
+    bool running = reference.beginFrame();
+
+    if (running != candidate.beginFrame()) {
+        ++comparisonCount;
+        report(aFrame, 0, nullptr, 0, 0);
+        return false;
+    }
+
+    if (running) {
+        unsigned int i = 0;
+
+        while (i < CYCLES_PER_FRAME && !candidate.yield) {
+            NativeBlock const* block = candidate.nativeBlock();
+
+            // Both machines agree here, so one copy rewinds either
+            if (block) {
+                before = reference.state();
+                nativeBefore = candidate.native;
+            }
+
+            unsigned int length = candidate.step(CYCLES_PER_FRAME - i);
+
+            executed.clear();
+
+            for (unsigned int n = 0; n < length && !reference.yield; ++n) {
+                record();
+                reference.tick();
+            }
+
+            ++stepCount;
+            ++comparisonCount;
+
+            if (diff(nullptr) || reference.yield != candidate.yield) {
+                report(aFrame, i, block, length, block ? locate(length) : length);
+                return false;
+            }
+
+            i += length;
+        }
+    }
+
+    reference.advanceTimers(1);
+    candidate.advanceTimers(1);
+
+    return true;
+}
+
+void Lockstep::record() {
+    uint16_t pc = reference.pc & MEM_HI;
+    executed.push_back(Executed{
+        pc, uint16_t(reference.memory[pc] << 8 | reference.memory[(pc + 1) & MEM_HI])});
+}
+
+// Rewind to before the block and run its instructions natively one at a time,
+// each from the reference's state, so a bad translation shows up on its own.
+// If none does, the block as a whole is replayed to leave the original
+// divergence in place
+unsigned int Lockstep::locate(unsigned int aLength) {
+    reference.restore(before);
+    candidate.native = nativeBefore;
+    executed.clear();
+
+    for (unsigned int n = 0; n < aLength && !reference.yield; ++n) {
+        candidate.restore(reference.state());
+        record();
+        candidate.step(1);
+        reference.tick();
+        ++comparisonCount;
+
+        if (diff(nullptr) || reference.yield != candidate.yield) {
+            return n;
+        }
+    }
+
+    reference.restore(before);
+    candidate.restore(before);
+    candidate.native = nativeBefore;
+    candidate.step(aLength);
+    executed.clear();
+
+    for (unsigned int n = 0; n < aLength && !reference.yield; ++n) {
+        record();
+        reference.tick();
+    }
+
+    return aLength;
+}
+
+unsigned int Lockstep::diff(std::ostream* aOut) const {
+    State const& a = reference.state();
+    State const& b = candidate.state();
+    unsigned int count = 0;
+
+    auto field = [&](char const* aName, unsigned long long aReference, unsigned long long aCandidate) {
+        if (aReference == aCandidate) {
+            return;
+        }
+
+        ++count;
+
+        if (aOut) {
+            char line[96];
+            snprintf(line, sizeof(line), "  %-12s reference 0x%llX, candidate 0x%llX",
+                     aName, aReference, aCandidate);
+            *aOut << line << "\n";
+        }
+    };
+
+    char name[16];
+
+    field("pc", a.pc, b.pc);
+    field("I", a.I, b.I);
+    field("sp", a.sp, b.sp);
+    field("opcode", a.opcode, b.opcode);
+
+    for (unsigned int i = 0; i < NUM_REGS; ++i) {
+        snprintf(name, sizeof(name), "V%X", i);
+        field(name, a.V[i], b.V[i]);
+    }
+
+    for (unsigned int i = 0; i < STACK_SIZE; ++i) {
+        snprintf(name, sizeof(name), "stack[%u]", i);
+        field(name, a.stack[i], b.stack[i]);
+    }
+
+    field("delay timer", a.delayTimer, b.delayTimer);
+    field("sound timer", a.sndTimer, b.sndTimer);
+    field("wait", a.wait, b.wait);
+    field("trap", a.fault.kind, b.fault.kind);
+    field("trap pc", a.fault.pc, b.fault.pc);
+    field("rng", a.rng, b.rng);
+    field("frame", a.frameCount, b.frameCount);
+    field("draws", a.drawCount, b.drawCount);
+
+    for (unsigned int y = 0; y < GFX_HEIGHT; ++y) {
+        snprintf(name, sizeof(name), "row %u", y);
+        field(name, a.rows[y], b.rows[y]);
+    }
+
+    if (memcmp(a.gfx, b.gfx, sizeof(a.gfx)) != 0) {
+        ++count;
+
+        if (aOut) {
+            *aOut << "  screen buffer differs\n";
+        }
+    }
+
+    unsigned int memoryDiffs = 0;
+
+    for (unsigned int addr = 0; addr < MAX_MEM; ++addr) {
+        if (a.memory[addr] == b.memory[addr]) {
+            continue;
+        }
+
+        if (++memoryDiffs <= LOCKSTEP_MEMORY_DIFFS) {
+            snprintf(name, sizeof(name), "mem[0x%03X]", addr);
+            field(name, a.memory[addr], b.memory[addr]);
+        } else {
+            ++count;
+        }
+    }
+
+    if (aOut && memoryDiffs > LOCKSTEP_MEMORY_DIFFS) {
+        *aOut << "  ... " << memoryDiffs - LOCKSTEP_MEMORY_DIFFS << " more memory bytes differ\n";
+    }
+
+    return count;
+}
+
+void Lockstep::report(uint64_t aFrame, unsigned int aInstruction, NativeBlock const* aBlock,
+                      unsigned int aLength, unsigned int aCulprit) const {
+    char line[96];
+
+    out << "divergence in frame " << aFrame << " after step " << stepCount;
+
+    if (!aLength) {
+        out << ": only one machine is waiting\n";
+    } else if (aBlock && aCulprit < aLength) {
+        snprintf(line, sizeof(line), ": native block 0x%03X-0x%03X, instruction %u of the block",
+                 aBlock->start, aBlock->end, aCulprit);
+        out << line << " (" << aInstruction + aCulprit << " of the frame) differs on its own\n";
+    } else if (aBlock) {
+        snprintf(line, sizeof(line), ": native block 0x%03X-0x%03X ran %u instructions",
+                 aBlock->start, aBlock->end, aLength);
+        out << line << " from instruction " << aInstruction << " of the frame";
+        out << "; every instruction agrees on its own\n";
+    } else {
+        out << ": interpreted instruction " << aInstruction << " of the frame\n";
+    }
+
+    for (size_t n = 0; aLength && n < executed.size(); ++n) {
+        Executed const& e = executed[n];
+        snprintf(line, sizeof(line), "  0x%03X  %04X  ", e.pc, e.opcode);
+        out << line << disassemble(e.opcode) << (n == aCulprit ? "  <--" : "") << "\n";
+    }
+
+    if (aLength && aCulprit == aLength && executed.size() < aLength) {
+        out << "  reference stopped after " << executed.size() << " instructions\n";
+    }
+
+    if (reference.yield != candidate.yield) {
+        out << "  yield        reference " << reference.yield << ", candidate "
+            << candidate.yield << "\n";
+    }
+
+    diff(&out);
+    out.flush();
+}
+} // chip8 namespace
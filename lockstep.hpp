@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "chip8.hpp"
+#include "keyscript.hpp"
+
+namespace chip8 {
+// Differential execution: run the reference interpreter and a candidate core
+// (normally one with a native module loaded) side by side on the same ROM and
+// input. With an interval of 0 the full state is compared after every step,
+// a step being one native block or one interpreted instruction; a block that
+// diverges is rerun one instruction at a time to name the instruction. With
+// an interval of N frames only state hashes are compared, every N frames; on
+// a mismatch both machines rewind to the last matching checkpoint and replay
+// step by step to find the exact instruction.
+class Lockstep final {
+    public:
+        Lockstep(Chip8& aReference, Chip8& aCandidate, std::ostream& aOut);
+
+        // Returns true if the machines agree for the whole script
+        bool run(KeyScript const& aScript, unsigned int aInterval);
+
+        uint64_t steps() const { return stepCount; }
+        uint64_t comparisons() const { return comparisonCount; }
+
+    private:
+        struct Executed {
+            uint16_t pc;
+            uint16_t opcode;
+        };
+
+        // One frame compared after every step. Returns false on divergence
+        bool stepFrame(uint64_t aFrame);
+
+        // Count the differences between the machines, listing them if aOut
+        unsigned int diff(std::ostream* aOut) const;
+
+        // Note the instruction the reference is about to execute
+        void record();
+
+        // The native step of aLength instructions from before diverged.
+        // Returns the index of the first instruction that diverges when run
+        // alone, or aLength if none does
+        unsigned int locate(unsigned int aLength);
+
+        // aCulprit: from locate(), or aLength to list the whole step
+        void report(uint64_t aFrame, unsigned int aInstruction, NativeBlock const* aBlock,
+                    unsigned int aLength, unsigned int aCulprit) const;
+
+        Chip8& reference;
+        Chip8& candidate;
+        std::ostream& out;
+
+        // What the reference ran in the current step
+        std::vector<Executed> executed;
+
+        // Both machines before the current native step, and the candidate's
+        // blocks then; a block may invalidate itself
+        Chip8::Snapshot before;
+        std::shared_ptr<Chip8::NativeMap> nativeBefore;
+
+        uint64_t stepCount{};
+        uint64_t comparisonCount{};
+};
+} // chip8 namespace
@@ -1,9 +1,479 @@
+#include <chrono>
+#include <cstdio>
 #include <iostream>
+#include <string>
+#include <thread>
+
+#include "analyzer.hpp"
+#include "capture.hpp"
 #include "chip8.hpp"
+#include "debugger.hpp"
+#include "fuzzer.hpp"
+#include "gdbstub.hpp"
+#include "gfx.hpp"
+#include "golden.hpp"
+#include "keyscript.hpp"
+#include "lockstep.hpp"
+#include "metrics.hpp"
+#include "recompiler.hpp"
+#include "shm.hpp"
+#include "terminal.hpp"
+
+static int usage(char const* aProgram) {
+    std::cerr << "usage: " << aProgram << " ROM\n"
+              << "       " << aProgram << " --disasm ROM [text|dot|json]\n"
+              << "       " << aProgram << " --debug ROM\n"
+              << "       " << aProgram << " --gdb PORT ROM\n"
+              << "       " << aProgram << " --headless ROM FRAMES [MODULE]\n"
+              << "       " << aProgram << " --aot ROM MODULE [INCLUDE_DIR]\n"
+              << "       " << aProgram << " --native MODULE ROM\n"
+              << "       " << aProgram << " --runahead FRAMES ROM\n"
+              << "       " << aProgram << " --fuzz ROM SECONDS [THREADS] [OUTDIR]\n"
+              << "       " << aProgram << " --replay ROM KEYS\n"
+              << "       " << aProgram << " --metrics PORT|FILE ROM\n"
+              << "       " << aProgram << " --capture png|gif|raw PATH ROM [FRAMES]\n"
+              << "       " << aProgram << " --shm NAME ROM\n"
+              << "       " << aProgram << " --peek NAME [KEYS|release|quit]\n"
+              << "       " << aProgram << " --term ROM [half|braille]\n"
+              << "       " << aProgram << " --golden record|check ROM KEYS GOLDEN [MODULE]\n"
+              << "       " << aProgram << " --lockstep ROM KEYS MODULE [step|FRAMES]" << std::endl;
+    return 1;
+}
+
+// Open a window and run in real time until it is closed
+static void play(chip8::Chip8& aEmulator) {
+    int videoScale = 10;
+
+    // Mostly sanity checks
+    std::cout << "Booting with " << MAX_MEM << " bytes of memory (usable = "
+              << MEM_HI - MEM_LO << " bytes)" << std::endl;
+
+    chip8::Gfx gfx("CHIP-8 Emulator", GFX_WIDTH * videoScale, GFX_HEIGHT * videoScale,
+                   GFX_WIDTH, GFX_HEIGHT);
+    aEmulator.emulate(gfx);
+}
 
 int main(int argc, char** argv) {
+    if (argc < 2) {
+        return usage(argv[0]);
+    }
+
+    std::string mode = argv[1];
+
+    if (mode == "--disasm") {
+        if (argc < 3) {
+            return usage(argv[0]);
+        }
+
+        chip8::Analyzer analyzer(argv[2]);
+        analyzer.analyze();
+
+        std::string format = argc > 3 ? argv[3] : "text";
+
+        if (format == "dot") {
+            analyzer.dumpDot(std::cout);
+        } else if (format == "json") {
+            analyzer.dumpJson(std::cout);
+        } else {
+            analyzer.dumpText(std::cout);
+        }
+
+        return 0;
+    }
+
+    if (mode == "--debug") {
+        if (argc < 3) {
+            return usage(argv[0]);
+        }
+
+        chip8::Chip8 emulator(argv[2]);
+        chip8::Debugger debugger(emulator);
+        play(emulator);
+
+        return 0;
+    }
+
+    if (mode == "--gdb") {
+        if (argc < 4) {
+            return usage(argv[0]);
+        }
+
+        chip8::Chip8 emulator(argv[3]);
+        chip8::GdbStub stub(emulator, std::stoi(argv[2]));
+        play(emulator);
+
+        return 0;
+    }
+
+    if (mode == "--metrics") {
+        if (argc < 4) {
+            return usage(argv[0]);
+        }
+
+        chip8::Chip8 emulator(argv[3]);
+        chip8::Metrics metrics;
+        chip8::MetricsExporter exporter(metrics, argv[2]);
+        emulator.setMetrics(&metrics);
+        play(emulator);
+
+        return 0;
+    }
+
+    if (mode == "--capture") {
+        if (argc < 5) {
+            return usage(argv[0]);
+        }
+
+        std::string format = argv[2];
+        chip8::CaptureFormat captureFormat;
+
+        if (format == "png") {
+            captureFormat = chip8::CAPTURE_PNG;
+        } else if (format == "gif") {
+            captureFormat = chip8::CAPTURE_GIF;
+        } else if (format == "raw") {
+            captureFormat = chip8::CAPTURE_RAW;
+        } else {
+            return usage(argv[0]);
+        }
+
+        chip8::Chip8 emulator(argv[4]);
+        chip8::Capture capture(argv[3], captureFormat);
+
+        if (!capture.valid()) {
+            return 1;
+        }
+
+        emulator.setCapture(&capture);
+
+        if (argc > 5) {
+            emulator.runFrames(std::stoull(argv[5]));
+        } else {
+            play(emulator);
+        }
+
+        emulator.setCapture(nullptr);
+        capture.close();
+        std::cout << capture.written() << " frames captured, " << capture.dropped()
+                  << " dropped";
+
+        if (capture.failed()) {
+            std::cout << ", " << capture.failed() << " failed";
+        }
+
+        std::cout << std::endl;
+
+        return capture.failed() ? 1 : 0;
+    }
+
+    if (mode == "--shm") {
+        if (argc < 4) {
+            return usage(argv[0]);
+        }
+
+        chip8::Chip8 emulator(argv[3]);
+        chip8::SharedExport shared(emulator, argv[2]);
+
+        if (!shared.valid()) {
+            return 1;
+        }
+
+        emulator.emulate(shared);
+
+        return 0;
+    }
+
+    if (mode == "--peek") {
+        if (argc < 3) {
+            return usage(argv[0]);
+        }
+
+        chip8::SharedView view(argv[2]);
+
+        if (!view.valid()) {
+            return 1;
+        }
+
+        if (argc > 3) {
+            std::string command = argv[3];
+
+            if (command == "release") {
+                view.release();
+            } else if (command == "quit") {
+                view.quit();
+            } else {
+                view.inject(std::stoul(command, nullptr, 16));
+            }
+
+            return 0;
+        }
+
+        chip8::SharedFrame frame;
+        view.read(frame);
+
+        for (int y = 0; y < GFX_HEIGHT; ++y) {
+            for (int x = 0; x < GFX_WIDTH; ++x) {
+                int bit = y * GFX_WIDTH + x;
+                std::cout << ((frame.screen[bit / 8] >> (7 - bit % 8)) & 1u ? '#' : '.');
+            }
+
+            std::cout << "\n";
+        }
+
+        char registers[160];
+        snprintf(registers, sizeof(registers),
+                 "frame %llu pc=%03X I=%03X sp=%u DT=%02X ST=%02X keys=%04X trap=%u",
+                 (unsigned long long)frame.frame, frame.pc, frame.I, frame.sp,
+                 frame.delayTimer, frame.sndTimer, frame.keys, frame.trap);
+        std::cout << registers << "\nV:";
+
+        for (uint8_t v : frame.V) {
+            snprintf(registers, sizeof(registers), " %02X", v);
+            std::cout << registers;
+        }
+
+        std::cout << std::endl;
+        return 0;
+    }
+
+    if (mode == "--term") {
+        if (argc < 3) {
+            return usage(argv[0]);
+        }
+
+        chip8::TerminalMode terminalMode = chip8::TERMINAL_HALF_BLOCK;
+
+        if (argc > 3 && std::string(argv[3]) == "braille") {
+            terminalMode = chip8::TERMINAL_BRAILLE;
+        }
+
+        chip8::Chip8 emulator(argv[2]);
+        uint64_t bytes = 0;
+        uint64_t frames = 0;
+
+        {
+            chip8::Terminal terminal(terminalMode);
+            emulator.emulate(terminal);
+            bytes = terminal.bytesWritten();
+            frames = terminal.framesDrawn();
+        }
+
+        std::cout << bytes << " bytes sent over " << frames << " frames ("
+                  << (frames ? bytes / double(frames) : 0) << " per frame)" << std::endl;
+
+        return 0;
+    }
+
+    if (mode == "--golden") {
+        if (argc < 6) {
+            return usage(argv[0]);
+        }
+
+        std::string action = argv[2];
+        chip8::KeyScript script;
+
+        if (!script.load(argv[4])) {
+            std::cerr << "Failed to read key script" << std::endl;
+            return 1;
+        }
+
+        chip8::Chip8 emulator(argv[3]);
+
+        if (argc > 6 && !emulator.loadNative(argv[6])) {
+            return 1;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        chip8::Golden actual;
+        actual.record(emulator, script);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (action == "record") {
+            if (!actual.save(argv[5])) {
+                std::cerr << "Failed to write golden file" << std::endl;
+                return 1;
+            }
+
+            std::cout << actual.frames.size() << " frames recorded in " << seconds * 1000
+                      << " ms" << std::endl;
+            return 0;
+        }
+
+        if (action != "check") {
+            return usage(argv[0]);
+        }
+
+        chip8::Golden expected;
+
+        if (!expected.load(argv[5])) {
+            std::cerr << "Failed to read golden file" << std::endl;
+            return 1;
+        }
+
+        size_t frame = expected.frames.size();
+
+        if (!expected.compare(actual, std::cout, &frame)) {
+            // Narrow it down on a second machine, run exactly as the first
+            if (frame < expected.frames.size()) {
+                chip8::Chip8 replay(argv[3]);
+
+                if (argc <= 6 || replay.loadNative(argv[6])) {
+                    expected.locate(replay, script, frame, std::cout);
+                }
+            }
+
+            return 1;
+        }
+
+        std::cout << actual.frames.size() << " frames match (" << seconds * 1000 << " ms)"
+                  << std::endl;
+        return 0;
+    }
+
+    if (mode == "--lockstep") {
+        if (argc < 5) {
+            return usage(argv[0]);
+        }
+
+        chip8::KeyScript script;
+
+        if (!script.load(argv[3])) {
+            std::cerr << "Failed to read key script" << std::endl;
+            return 1;
+        }
+
+        chip8::Chip8 reference(argv[2]);
+        chip8::Chip8 candidate(argv[2]);
+
+        if (!candidate.loadNative(argv[4])) {
+            return 1;
+        }
+
+        // Every step by default, otherwise hashes every FRAMES frames
+        std::string granularity = argc > 5 ? argv[5] : "step";
+        unsigned int interval = granularity == "step" ? 0 : std::stoul(granularity);
+
+        auto start = std::chrono::steady_clock::now();
+        chip8::Lockstep lockstep(reference, candidate, std::cout);
+        bool agreed = lockstep.run(script, interval);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << (agreed ? "cores agree" : "cores diverge") << " after "
+                  << lockstep.comparisons() << " comparisons, " << lockstep.steps()
+                  << " steps run in lockstep (" << seconds * 1000 << " ms)" << std::endl;
+        return agreed ? 0 : 1;
+    }
+
+    if (mode == "--headless") {
+        if (argc < 4) {
+            return usage(argv[0]);
+        }
+
+        chip8::Chip8 emulator(argv[2]);
+        uint64_t frames = std::stoull(argv[3]);
+
+        if (argc > 4 && !emulator.loadNative(argv[4])) {
+            return 1;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        uint64_t executed = emulator.runFrames(frames);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << frames << " frames, " << executed << " instructions in "
+                  << seconds * 1000 << " ms (" << executed / seconds << " instructions/s)"
+                  << std::endl;
+
+        if (emulator.lastTrap().kind) {
+            std::cerr << chip8::describe(emulator.lastTrap()) << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (mode == "--aot") {
+        if (argc < 4) {
+            return usage(argv[0]);
+        }
+
+        chip8::Recompiler recompiler(argv[2]);
+        return recompiler.compile(argv[3], argc > 4 ? argv[4] : ".") ? 0 : 1;
+    }
+
+    if (mode == "--native") {
+        if (argc < 4) {
+            return usage(argv[0]);
+        }
+
+        chip8::Chip8 emulator(argv[3]);
+
+        if (!emulator.loadNative(argv[2])) {
+            return 1;
+        }
+
+        play(emulator);
+
+        return 0;
+    }
+
+    if (mode == "--runahead") {
+        if (argc < 4) {
+            return usage(argv[0]);
+        }
+
+        chip8::Chip8 emulator(argv[3]);
+        emulator.setRunAhead(std::stoi(argv[2]));
+        play(emulator);
+
+        return 0;
+    }
+
+    if (mode == "--fuzz") {
+        if (argc < 4) {
+            return usage(argv[0]);
+        }
+
+        unsigned int threads = argc > 4 ? std::stoi(argv[4])
+                                        : std::max(1u, std::thread::hardware_concurrency());
+
+        chip8::Fuzzer fuzzer(argv[2], argc > 5 ? argv[5] : ".");
+        fuzzer.run(std::stod(argv[3]), threads);
+
+        return 0;
+    }
+
+    if (mode == "--replay") {
+        if (argc < 4) {
+            return usage(argv[0]);
+        }
+
+        chip8::KeyScript script;
+
+        if (!script.load(argv[3])) {
+            std::cerr << "Failed to read key script" << std::endl;
+            return 1;
+        }
+
+        chip8::Chip8 emulator(argv[2]);
+        emulator.seed(script.seed);
+
+        for (uint16_t keys : script.keys) {
+            emulator.setKeys(keys);
+            emulator.runFrames(1);
+        }
+
+        if (emulator.lastTrap().kind) {
+            std::cerr << chip8::describe(emulator.lastTrap()) << std::endl;
+            return 1;
+        }
+
+        std::cout << script.keys.size() << " frames replayed" << std::endl;
+        return 0;
+    }
+
     chip8::Chip8 emulator(argv[1]);
-    emulator.emulate();
+    play(emulator);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,152 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "metrics.hpp"
+
+namespace chip8 {
+void Histogram::record(uint64_t aValue) {
+    unsigned int bucket = aValue ? 64 - __builtin_clzll(aValue) : 0;
+
+    bump(buckets[bucket < METRICS_BUCKETS ? bucket : METRICS_BUCKETS - 1]);
+    bump(count);
+    bump(sum, aValue);
+}
+
+void Histogram::write(std::ostream& aOut, char const* aName, char const* aHelp,
+                      double aScale) const {
+    aOut << "# HELP " << aName << " " << aHelp << "\n"
+         << "# TYPE " << aName << " histogram\n";
+
+    // Bucket i holds values up to 2^i - 1; the last one is open ended
+    uint64_t cumulative = 0;
+
+    for (unsigned int i = 0; i < METRICS_BUCKETS - 1; ++i) {
+        cumulative += buckets[i].load(std::memory_order_relaxed);
+        aOut << aName << "_bucket{le=\"" << ((1ull << i) - 1) * aScale << "\"} "
+             << cumulative << "\n";
+    }
+
+    // Read the total last so the +Inf bucket is never below the finite ones
+    uint64_t total = std::max(cumulative + buckets[METRICS_BUCKETS - 1].load(std::memory_order_relaxed),
+                              count.load(std::memory_order_relaxed));
+
+    aOut << aName << "_bucket{le=\"+Inf\"} " << total << "\n"
+         << aName << "_sum " << sum.load(std::memory_order_relaxed) * aScale << "\n"
+         << aName << "_count " << total << "\n";
+}
+
+void Metrics::write(std::ostream& aOut) const {
+    instsPerFrame.write(aOut, "chip8_instructions_per_frame",
+                        "Instructions executed per emulated frame");
+    frameJitter.write(aOut, "chip8_frame_jitter_seconds",
+                      "Delay between a frame being due and starting", 1e-6);
+    updateTime.write(aOut, "chip8_gfx_update_seconds", "Time spent presenting a frame, run-ahead included", 1e-6);
+    inputTime.write(aOut, "chip8_gfx_input_seconds", "Time spent polling input", 1e-6);
+
+    aOut << "# HELP chip8_frames_total Frames emulated\n"
+         << "# TYPE chip8_frames_total counter\n"
+         << "chip8_frames_total " << frames.load(std::memory_order_relaxed) << "\n"
+         << "# HELP chip8_late_frames_total Frames finished after the next one was due\n"
+         << "# TYPE chip8_late_frames_total counter\n"
+         << "chip8_late_frames_total " << lateFrames.load(std::memory_order_relaxed) << "\n"
+         << "# HELP chip8_dropped_frames_total Frames skipped after falling behind\n"
+         << "# TYPE chip8_dropped_frames_total counter\n"
+         << "chip8_dropped_frames_total " << droppedFrames.load(std::memory_order_relaxed) << "\n";
+}
+
+MetricsExporter::MetricsExporter(Metrics const& aMetrics, std::string const& aTarget)
+    : metrics(aMetrics) {
+    if (aTarget.empty() || aTarget.find_first_not_of("0123456789") != std::string::npos) {
+        path = aTarget;
+        thread = std::thread(&MetricsExporter::writeFile, this);
+        return;
+    }
+
+    int port = std::stoi(aTarget);
+    server = socket(AF_INET, SOCK_STREAM, 0);
+
+    int yes = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (server < 0 || bind(server, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(server, 4) < 0) {
+        std::cerr << "Failed to listen for metrics on port " << port << std::endl;
+        return;
+    }
+
+    std::cout << "Serving metrics on http://localhost:" << port << "/metrics" << std::endl;
+    thread = std::thread(&MetricsExporter::serve, this);
+}
+
+MetricsExporter::~MetricsExporter() {
+    shutdown = true;
+
+    // Unblock accept() on the server thread
+    if (server >= 0) {
+        ::shutdown(server, SHUT_RDWR);
+        close(server);
+    }
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void MetricsExporter::serve() {
+    while (!shutdown) {
+        int fd = accept(server, nullptr, nullptr);
+
+        if (fd < 0) {
+            break;
+        }
+
+        // Whatever was asked for, the answer is the same
+        char request[1024];
+        recv(fd, request, sizeof(request), 0);
+
+        std::ostringstream body;
+        metrics.write(body);
+
+        std::string text = body.str();
+        std::string response = "HTTP/1.0 200 OK\r\n"
+                               "Content-Type: text/plain; version=0.0.4\r\n"
+                               "Content-Length: " + std::to_string(text.size()) + "\r\n"
+                               "Connection: close\r\n\r\n" + text;
+
+        send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+        close(fd);
+    }
+}
+
+void MetricsExporter::writeFile() {
+    std::string temp = path + ".tmp";
+
+    while (!shutdown) {
+        // Replace the file atomically so readers never see half of it
+        {
+            std::ofstream out(temp, std::ios::trunc);
+            metrics.write(out);
+        }
+
+        std::rename(temp.c_str(), path.c_str());
+
+        for (int i = 0; i < 10 && !shutdown; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+}
+} // chip8 namespace
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <thread>
+
+namespace chip8 {
+// Counters have a single writer, so an increment needs no locked instruction
+inline void bump(std::atomic<uint64_t>& aCounter, uint64_t aValue = 1) {
+    aCounter.store(aCounter.load(std::memory_order_relaxed) + aValue,
+                   std::memory_order_relaxed);
+}
+
+// Histogram buckets are powers of two: bucket i counts values that need i bits
+#define METRICS_BUCKETS 32
+
+// Log2 histogram with a single writer. Updates are plain relaxed loads and
+// stores, so recording costs a few instructions and never takes a lock;
+// readers on other threads see a consistent-enough view for monitoring.
+class Histogram final {
+    public:
+        void record(uint64_t aValue);
+
+        // Prometheus histogram; bucket bounds and the sum are multiplied by aScale
+        void write(std::ostream& aOut, char const* aName, char const* aHelp,
+                   double aScale = 1) const;
+
+    private:
+        std::atomic<uint64_t> buckets[METRICS_BUCKETS]{};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+};
+
+// Counters filled in by Chip8::emulate() on the emulation thread
+struct Metrics {
+    Histogram instsPerFrame;
+    // Microseconds between when a frame was due and when it started
+    Histogram frameJitter;
+    // Microseconds spent in Frontend::update (plus the speculative frames
+    // when running ahead) and Frontend::input
+    Histogram updateTime;
+    Histogram inputTime;
+
+    std::atomic<uint64_t> frames{0};
+    // Finished after the next frame was due
+    std::atomic<uint64_t> lateFrames{0};
+    // Skipped entirely after falling more than a frame behind
+    std::atomic<uint64_t> droppedFrames{0};
+
+    // Prometheus text exposition format
+    void write(std::ostream& aOut) const;
+};
+
+// Publishes a Metrics block from a background thread. A numeric target is a
+// port served over HTTP on 127.0.0.1 for Prometheus to scrape; anything else is
+// a file path rewritten once a second.
+class MetricsExporter final {
+    public:
+        MetricsExporter(Metrics const& aMetrics, std::string const& aTarget);
+        ~MetricsExporter();
+
+    private:
+        void serve();
+        void writeFile();
+
+        Metrics const& metrics;
+        std::string path;
+        int server{-1};
+
+        std::atomic<bool> shutdown{false};
+        std::thread thread;
+};
+} // chip8 namespace
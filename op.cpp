@@ -0,0 +1,157 @@
+#include <cstdio>
+
+#include "op.hpp"
+
+namespace chip8 {
+std::array<Op, OP_TABLE_SIZE> const opTable = {
+    OP_GROUP0, OP_1NNN, OP_2NNN, OP_3XKK, OP_4XKK, OP_5XY0, OP_6XKK, OP_7XKK,
+    OP_GROUP8, OP_9XY0, OP_ANNN, OP_BNNN, OP_CXKK, OP_DXYN, OP_GROUPE, OP_GROUPF
+};
+
+// Unlisted slots stay OP_INVALID
+static constexpr std::array<Op, OP_TABLE0_SIZE> makeTable0() {
+    std::array<Op, OP_TABLE0_SIZE> table{};
+    table[0x0] = OP_00E0;
+    table[0xE] = OP_00EE;
+    return table;
+}
+
+static constexpr std::array<Op, OP_TABLE8_SIZE> makeTable8() {
+    std::array<Op, OP_TABLE8_SIZE> table{};
+    table[0x0] = OP_8XY0;
+    table[0x1] = OP_8XY1;
+    table[0x2] = OP_8XY2;
+    table[0x3] = OP_8XY3;
+    table[0x4] = OP_8XY4;
+    table[0x5] = OP_8XY5;
+    table[0x6] = OP_8XY6;
+    table[0x7] = OP_8XY7;
+    table[0xE] = OP_8XYE;
+    return table;
+}
+
+static constexpr std::array<Op, OP_TABLEE_SIZE> makeTableE() {
+    std::array<Op, OP_TABLEE_SIZE> table{};
+    table[0x1] = OP_EXA1;
+    table[0xE] = OP_EX9E;
+    return table;
+}
+
+static constexpr std::array<Op, OP_TABLEF_SIZE> makeTableF() {
+    std::array<Op, OP_TABLEF_SIZE> table{};
+    table[0x07] = OP_FX07;
+    table[0x0A] = OP_FX0A;
+    table[0x15] = OP_FX15;
+    table[0x18] = OP_FX18;
+    table[0x1E] = OP_FX1E;
+    table[0x29] = OP_FX29;
+    table[0x33] = OP_FX33;
+    table[0x55] = OP_FX55;
+    table[0x65] = OP_FX65;
+    return table;
+}
+
+std::array<Op, OP_TABLE0_SIZE> const opTable0 = makeTable0();
+std::array<Op, OP_TABLE8_SIZE> const opTable8 = makeTable8();
+std::array<Op, OP_TABLEE_SIZE> const opTableE = makeTableE();
+std::array<Op, OP_TABLEF_SIZE> const opTableF = makeTableF();
+
+// Indexed by Op, keep in enum order
+std::array<OpInfo, OP_COUNT> const opInfo = {{
+    {"DW 0x%o", FLOW_INVALID},
+    {"", FLOW_INVALID},
+    {"", FLOW_INVALID},
+    {"", FLOW_INVALID},
+    {"", FLOW_INVALID},
+    {"CLS", FLOW_NEXT},
+    {"RET", FLOW_RET},
+    {"JP 0x%a", FLOW_JUMP},
+    {"CALL 0x%a", FLOW_CALL},
+    {"SE V%x, 0x%k", FLOW_SKIP},
+    {"SNE V%x, 0x%k", FLOW_SKIP},
+    {"SE V%x, V%y", FLOW_SKIP},
+    {"LD V%x, 0x%k", FLOW_NEXT},
+    {"ADD V%x, 0x%k", FLOW_NEXT},
+    {"LD V%x, V%y", FLOW_NEXT},
+    {"OR V%x, V%y", FLOW_NEXT},
+    {"AND V%x, V%y", FLOW_NEXT},
+    {"XOR V%x, V%y", FLOW_NEXT},
+    {"ADD V%x, V%y", FLOW_NEXT},
+    {"SUB V%x, V%y", FLOW_NEXT},
+    {"SHR V%x", FLOW_NEXT},
+    {"SUBN V%x, V%y", FLOW_NEXT},
+    {"SHL V%x", FLOW_NEXT},
+    {"SNE V%x, V%y", FLOW_SKIP},
+    {"LD I, 0x%a", FLOW_NEXT},
+    {"JP V0, 0x%a", FLOW_COMPUTED},
+    {"RND V%x, 0x%k", FLOW_NEXT},
+    {"DRW V%x, V%y, %n", FLOW_NEXT},
+    {"SKP V%x", FLOW_SKIP},
+    {"SKNP V%x", FLOW_SKIP},
+    {"LD V%x, DT", FLOW_NEXT},
+    {"LD V%x, K", FLOW_NEXT},
+    {"LD DT, V%x", FLOW_NEXT},
+    {"LD ST, V%x", FLOW_NEXT},
+    {"ADD I, V%x", FLOW_NEXT},
+    {"LD F, V%x", FLOW_NEXT},
+    {"LD B, V%x", FLOW_NEXT},
+    {"LD [I], V%x", FLOW_NEXT},
+    {"LD V%x, [I]", FLOW_NEXT}
+}};
+
+Op decode(uint16_t aOpcode) {
+    Op op = opTable[(aOpcode & 0xF000u) >> 12u];
+
+    switch (op) {
+        case OP_GROUP0:
+            return opTable0[aOpcode & 0x000Fu];
+        case OP_GROUP8:
+            return opTable8[aOpcode & 0x000Fu];
+        case OP_GROUPE:
+            return opTableE[aOpcode & 0x000Fu];
+        case OP_GROUPF:
+            return opTableF[aOpcode & 0x00FFu];
+        default:
+            return op;
+    }
+}
+
+std::string disassemble(uint16_t aOpcode) {
+    Op op = decode(aOpcode);
+    char const* format = opInfo[op].format;
+    std::string text;
+    char buf[8];
+
+    for (char const* c = format; *c; ++c) {
+        if (*c != '%') {
+            text += *c;
+            continue;
+        }
+
+        switch (*++c) {
+            case 'x':
+                snprintf(buf, sizeof(buf), "%X", (aOpcode & 0x0F00u) >> 8u);
+                break;
+            case 'y':
+                snprintf(buf, sizeof(buf), "%X", (aOpcode & 0x00F0u) >> 4u);
+                break;
+            case 'n':
+                snprintf(buf, sizeof(buf), "%u", aOpcode & 0x000Fu);
+                break;
+            case 'k':
+                snprintf(buf, sizeof(buf), "%02X", aOpcode & 0x00FFu);
+                break;
+            case 'a':
+                snprintf(buf, sizeof(buf), "%03X", aOpcode & 0x0FFFu);
+                break;
+            default:
+                snprintf(buf, sizeof(buf), "%04X", aOpcode);
+                break;
+        }
+
+        text += buf;
+    }
+
+    return text;
+}
+} // chip8 namespace
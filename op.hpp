@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace chip8 {
+// Decoded instruction classes. These tables are the single description of the
+// CHIP-8 encoding: Chip8::loadInsts() binds them to member functions for
+// execution and the offline tools (disassembler, analyzer) read them directly.
+// The top nibble selects an entry in opTable; the 0, 8, E and F groups escape
+// to a second table indexed by the low nibble (low byte for group F).
+enum Op : uint8_t {
+    OP_INVALID,
+    OP_GROUP0,
+    OP_GROUP8,
+    OP_GROUPE,
+    OP_GROUPF,
+    OP_00E0,
+    OP_00EE,
+    OP_1NNN,
+    OP_2NNN,
+    OP_3XKK,
+    OP_4XKK,
+    OP_5XY0,
+    OP_6XKK,
+    OP_7XKK,
+    OP_8XY0,
+    OP_8XY1,
+    OP_8XY2,
+    OP_8XY3,
+    OP_8XY4,
+    OP_8XY5,
+    OP_8XY6,
+    OP_8XY7,
+    OP_8XYE,
+    OP_9XY0,
+    OP_ANNN,
+    OP_BNNN,
+    OP_CXKK,
+    OP_DXYN,
+    OP_EX9E,
+    OP_EXA1,
+    OP_FX07,
+    OP_FX0A,
+    OP_FX15,
+    OP_FX18,
+    OP_FX1E,
+    OP_FX29,
+    OP_FX33,
+    OP_FX55,
+    OP_FX65,
+    OP_COUNT
+};
+
+// How an instruction affects the program counter
+enum Flow : uint8_t {
+    FLOW_NEXT,      // Falls through to pc + 2
+    FLOW_JUMP,      // 1nnn
+    FLOW_CALL,      // 2nnn
+    FLOW_RET,       // 00EE
+    FLOW_SKIP,      // Continues at pc + 2 or pc + 4
+    FLOW_COMPUTED,  // Bnnn, target depends on V0
+    FLOW_INVALID    // Not a CHIP-8 instruction
+};
+
+struct OpInfo {
+    // Operands are written as %x, %y (register nibbles), %n (low nibble),
+    // %k (low byte), %a (12-bit address) and %o (whole opcode)
+    char const* format;
+    Flow flow;
+};
+
+#define OP_TABLE_SIZE 0x10
+// Sub-tables cover every value of their index so any opcode decodes safely
+#define OP_TABLE0_SIZE 0x10
+#define OP_TABLE8_SIZE 0x10
+#define OP_TABLEE_SIZE 0x10
+#define OP_TABLEF_SIZE 0x100
+
+extern std::array<Op, OP_TABLE_SIZE> const opTable;
+extern std::array<Op, OP_TABLE0_SIZE> const opTable0;
+extern std::array<Op, OP_TABLE8_SIZE> const opTable8;
+extern std::array<Op, OP_TABLEE_SIZE> const opTableE;
+extern std::array<Op, OP_TABLEF_SIZE> const opTableF;
+extern std::array<OpInfo, OP_COUNT> const opInfo;
+
+// Resolve an opcode through the dispatch tables, exactly as the interpreter does
+Op decode(uint16_t aOpcode);
+
+// Render an opcode in the usual Cowgod mnemonic syntax, e.g. "LD V3, 0x1F"
+std::string disassemble(uint16_t aOpcode);
+} // chip8 namespace
@@ -0,0 +1,193 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "chip8.hpp"
+#include "recompiler.hpp"
+
+namespace chip8 {
+// Chip8 member implementing each op; group escapes never reach codegen
+static char const* const handlers[OP_COUNT] = {
+    "OP_NULL", nullptr, nullptr, nullptr, nullptr,
+    "_00e0", "_00ee", "_1nnn", "_2nnn", "_3xkk", "_4xkk", "_5xy0", "_6xkk",
+    "_7xkk", "_8xy0", "_8xy1", "_8xy2", "_8xy3", "_8xy4", "_8xy5", "_8xy6",
+    "_8xy7", "_8xyE", "_9xy0", "_annn", "_bnnn", "_cxkk", "_dxyn", "_ex9e",
+    "_exa1", "_fx07", "_fx0a", "_fx15", "_fx18", "_fx1e", "_fx29", "_fx33",
+    "_fx55", "_fx65"
+};
+
+// Ops that may trap or start a wait in the middle of a block
+static bool mayYield(Op aOp) {
+    return aOp == OP_DXYN || aOp == OP_FX07 || aOp == OP_FX0A || aOp == OP_FX65;
+}
+
+// Ops that write memory. The block ends after them so that code they
+// overwrite is never run from a stale translation
+static bool writesMemory(Op aOp) {
+    return aOp == OP_FX33 || aOp == OP_FX55;
+}
+
+Recompiler::Recompiler(std::string aROMName)
+    : romName(aROMName)
+    , analyzer(aROMName) {
+    analyzer.analyze();
+}
+
+void Recompiler::emit(std::ostream& aOut) const {
+    struct Emitted {
+        uint16_t start;
+        uint16_t end;
+        uint16_t length;
+    };
+
+    std::vector<Emitted> emitted;
+    char line[160];
+
+    aOut << "// Generated by chip8 --aot from " << romName << ", do not edit\n"
+         << "#include \"chip8.hpp\"\n\n"
+         << "namespace chip8 {\n"
+         << "struct Native {\n";
+
+    for (auto const& entry : analyzer.blocks()) {
+        Analyzer::Block const& block = entry.second;
+        uint16_t pc = block.start;
+
+        while (pc < block.end) {
+            Emitted out{pc, pc, 0};
+
+            // Entered at any instruction through the switch; every
+            // instruction counts against the caller's budget
+            snprintf(line, sizeof(line), "    static unsigned int b%03X(Chip8& c, unsigned int n) {\n"
+                                         "        unsigned int i = 0;\n"
+                                         "        switch (c.pc) {\n"
+                                         "        default: return 0;\n", pc);
+            aOut << line;
+
+            for (; pc < block.end; pc += 2) {
+                uint16_t opcode = analyzer.fetch(pc);
+                Op op = decode(opcode);
+
+                // Leave invalid opcodes to the interpreter so it raises the trap
+                if (op == OP_INVALID) {
+                    pc = block.end;
+                    break;
+                }
+
+                snprintf(line, sizeof(line),
+                         "        case 0x%03X: c.pc = 0x%03X; c.opcode = 0x%04X; c.%s(); // %s\n",
+                         pc, pc + 2, opcode, handlers[op], disassemble(opcode).c_str());
+                aOut << line;
+                ++out.length;
+                out.end = pc + 2;
+
+                if (mayYield(op)) {
+                    aOut << "            if (++i == n || c.yield) return i;\n";
+                } else {
+                    aOut << "            if (++i == n) return i;\n";
+                }
+
+                if (writesMemory(op)) {
+                    pc += 2;
+                    break;
+                }
+            }
+
+            aOut << "        }\n"
+                 << "        return i;\n"
+                 << "    }\n";
+
+            if (out.length) {
+                emitted.push_back(out);
+            }
+        }
+    }
+
+    aOut << "};\n"
+         << "} // chip8 namespace\n\n"
+         << "#define EXPORT extern \"C\" __attribute__((visibility(\"default\")))\n\n"
+         << "EXPORT unsigned int const chip8_native_abi = " << NATIVE_ABI << ";\n\n"
+         << "EXPORT chip8::NativeBlock const chip8_native_blocks[] = {\n";
+
+    for (Emitted const& out : emitted) {
+        snprintf(line, sizeof(line), "    {0x%03X, 0x%03X, %u, &chip8::Native::b%03X},\n",
+                 out.start, out.end, out.length, out.start);
+        aOut << line;
+    }
+
+    aOut << "    {0, 0, 0, nullptr}\n"
+         << "};\n\n"
+         << "EXPORT uint8_t const chip8_native_rom[] = {";
+
+    uint16_t size = analyzer.imageEnd() - MEM_LO;
+
+    for (uint16_t i = 0; i < size; ++i) {
+        aOut << (i % 16 ? " " : "\n    ") << unsigned(analyzer.image()[MEM_LO + i]) << ",";
+    }
+
+    aOut << "\n    0\n};\n\n"
+         << "EXPORT uint16_t const chip8_native_rom_size = " << size << ";\n";
+}
+
+bool Recompiler::compile(std::string aOutput, std::string aIncludeDir) const {
+    std::string source = aOutput + ".cpp";
+    std::ofstream out(source);
+
+    if (!out.is_open()) {
+        std::cerr << "Failed to write " << source << std::endl;
+        return false;
+    }
+
+    emit(out);
+    out.close();
+
+    // Handlers resolve against the emulator binary, which exports them. $CXX
+    // and $CXXFLAGS are split on whitespace; paths are passed untouched
+    std::vector<std::string> args;
+    char const* cxx = getenv("CXX");
+    char const* cxxFlags = getenv("CXXFLAGS");
+    std::istringstream words(std::string(cxx && *cxx ? cxx : "g++") + " " +
+                             (cxxFlags ? cxxFlags : ""));
+    std::string word;
+
+    while (words >> word) {
+        args.push_back(word);
+    }
+
+    args.insert(args.begin() + 1, {"-std=c++17", "-O2", "-shared", "-fPIC", "-fvisibility=hidden"});
+    args.insert(args.end(), {"-I" + aIncludeDir, source, "-o", aOutput});
+
+    std::vector<char*> argv;
+
+    for (std::string& arg : args) {
+        argv.push_back(&arg[0]);
+    }
+
+    argv.push_back(nullptr);
+
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status = 0;
+
+    while (pid > 0 && waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+
+    if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cerr << "Failed to compile " << source << std::endl;
+        return false;
+    }
+
+    return true;
+}
+} // chip8 namespace
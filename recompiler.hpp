@@ -0,0 +1,27 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+#include "analyzer.hpp"
+
+namespace chip8 {
+// Ahead-of-time translation of a ROM into C++. Every block found by the
+// Analyzer becomes one function that calls the Chip8 instruction handlers
+// directly, with no fetch or decode. The result is built as a shared object
+// that Chip8::loadNative() maps in place of interpretation.
+class Recompiler final {
+    public:
+        Recompiler(std::string aROMName);
+
+        void emit(std::ostream& aOut) const;
+
+        // Write aOutput + ".cpp" and build it into aOutput with $CXX (g++ by
+        // default). aIncludeDir must contain the emulator headers
+        bool compile(std::string aOutput, std::string aIncludeDir) const;
+
+    private:
+        std::string romName;
+        Analyzer analyzer;
+};
+} // chip8 namespace
@@ -0,0 +1,172 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include "shm.hpp"
+
+namespace chip8 {
+// shm_open wants a single leading slash
+static std::string segmentName(std::string const& aName) {
+    return aName[0] == '/' ? aName : "/" + aName;
+}
+
+SharedExport::SharedExport(Chip8 const& aChip8, std::string aName)
+    : chip8(aChip8)
+    , name(segmentName(aName)) {
+    // One writer per segment: never take over another instance's
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+
+    if (fd < 0 && errno == EEXIST) {
+        std::cerr << "Shared memory segment " << name << " already exists. Another instance "
+                  << "is using it, or one that did not exit cleanly left it behind; in that "
+                  << "case remove /dev/shm" << name << std::endl;
+        return;
+    }
+
+    if (fd < 0 || ftruncate(fd, sizeof(SharedState)) < 0) {
+        std::cerr << "Failed to create shared memory segment " << name << std::endl;
+
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(name.c_str());
+        }
+
+        return;
+    }
+
+    void* memory = mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (memory == MAP_FAILED) {
+        std::cerr << "Failed to map shared memory segment " << name << std::endl;
+        return;
+    }
+
+    shared = new (memory) SharedState{};
+    shared->magic = SHM_MAGIC;
+    shared->version = SHM_VERSION;
+}
+
+SharedExport::~SharedExport() {
+    if (shared) {
+        munmap(shared, sizeof(SharedState));
+        shm_unlink(name.c_str());
+    }
+}
+
+void SharedExport::update(uint8_t const* buffer) {
+    if (!shared) {
+        return;
+    }
+
+    State const& state = chip8.state();
+    SharedFrame& frame = shared->frame;
+    uint32_t sequence = shared->sequence.load(std::memory_order_relaxed);
+
+    shared->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    frame.frame = state.frameCount;
+    frame.drawCount = state.drawCount;
+    frame.pc = state.pc;
+    frame.I = state.I;
+    frame.sp = state.sp;
+    frame.delayTimer = state.delayTimer;
+    frame.sndTimer = state.sndTimer;
+    frame.trap = state.fault.kind;
+    memcpy(frame.V, state.V, sizeof(frame.V));
+    memcpy(frame.stack, state.stack, sizeof(frame.stack));
+
+    frame.keys = 0;
+
+    for (int i = 0; i < MAX_KEYS; ++i) {
+        frame.keys |= (state.key[i] & 1u) << i;
+    }
+
+    // The screen only needs repacking when something was drawn
+    if (first || state.drawCount != publishedDraws) {
+        packScreen(buffer, frame.screen);
+        publishedDraws = state.drawCount;
+        first = false;
+    }
+
+    shared->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool SharedExport::input(uint8_t* keys) {
+    if (!shared) {
+        return false;
+    }
+
+    uint32_t input = shared->input.load(std::memory_order_relaxed);
+
+    if (input & SHM_INPUT_OVERRIDE) {
+        for (int i = 0; i < MAX_KEYS; ++i) {
+            keys[i] = (input >> i) & 1u;
+        }
+    }
+
+    return input & SHM_INPUT_QUIT;
+}
+
+SharedView::SharedView(std::string aName) {
+    std::string name = segmentName(aName);
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+
+    if (fd < 0) {
+        std::cerr << "No shared memory segment " << name << std::endl;
+        return;
+    }
+
+    void* memory = mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (memory == MAP_FAILED) {
+        std::cerr << "Failed to map shared memory segment " << name << std::endl;
+        return;
+    }
+
+    shared = static_cast<SharedState*>(memory);
+
+    if (shared->magic != SHM_MAGIC || shared->version != SHM_VERSION) {
+        std::cerr << "Segment " << name << " is not a CHIP-8 export" << std::endl;
+        munmap(shared, sizeof(SharedState));
+        shared = nullptr;
+    }
+}
+
+SharedView::~SharedView() {
+    if (shared) {
+        munmap(shared, sizeof(SharedState));
+    }
+}
+
+void SharedView::read(SharedFrame& aFrame) const {
+    uint32_t before;
+    uint32_t after;
+
+    do {
+        before = shared->sequence.load(std::memory_order_acquire);
+        memcpy(&aFrame, &shared->frame, sizeof(aFrame));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = shared->sequence.load(std::memory_order_relaxed);
+    } while ((before & 1u) || before != after);
+}
+
+void SharedView::inject(uint16_t aKeys) {
+    shared->input.store(SHM_INPUT_OVERRIDE | aKeys, std::memory_order_relaxed);
+}
+
+void SharedView::release() {
+    shared->input.store(0, std::memory_order_relaxed);
+}
+
+void SharedView::quit() {
+    shared->input.fetch_or(SHM_INPUT_QUIT, std::memory_order_relaxed);
+}
+} // chip8 namespace
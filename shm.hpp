@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "chip8.hpp"
+#include "frontend.hpp"
+
+namespace chip8 {
+#define SHM_MAGIC 0x48533843u // "C8SH"
+#define SHM_VERSION 1
+
+// Bits of SharedState::input, written by viewers. With SHM_INPUT_OVERRIDE set
+// the low 16 bits replace the emulator's key state
+#define SHM_INPUT_OVERRIDE 0x80000000u
+#define SHM_INPUT_QUIT 0x40000000u
+
+// Published machine state. Plain data, copied out by readers
+struct SharedFrame {
+    uint64_t frame;
+    uint32_t drawCount;
+    uint16_t pc;
+    uint16_t I;
+    uint16_t sp;
+    uint16_t keys;
+    uint16_t stack[STACK_SIZE];
+    uint8_t V[NUM_REGS];
+    uint8_t delayTimer;
+    uint8_t sndTimer;
+    uint8_t trap;
+    uint8_t screen[PACKED_SCREEN_SIZE];
+};
+
+// Layout of a segment. The emulator is the only writer of the seqlock
+// protected frame; sequence is odd while an update is in progress
+struct SharedState {
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> input;
+    SharedFrame frame;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "shared segments need address free atomics");
+
+// Headless frontend that publishes every frame into the POSIX shared memory
+// segment aName and takes its keys from there. Publishing is a few stores plus
+// repacking the screen when it changed; nothing on the emulation thread enters
+// the kernel after the segment is mapped. The segment is created exclusively
+// and unlinked on a clean exit; one left behind by a killed instance has to be
+// removed from /dev/shm before the name can be used again.
+class SharedExport final : public Frontend {
+    public:
+        SharedExport(Chip8 const& aChip8, std::string aName);
+        ~SharedExport();
+
+        bool valid() const { return shared != nullptr; }
+
+        void update(uint8_t const* buffer) override;
+        bool input(uint8_t* keys) override;
+
+    private:
+        Chip8 const& chip8;
+        std::string name;
+        SharedState* shared{};
+        uint32_t publishedDraws{};
+        bool first{true};
+};
+
+// Viewer side of a segment
+class SharedView final {
+    public:
+        SharedView(std::string aName);
+        ~SharedView();
+
+        bool valid() const { return shared != nullptr; }
+
+        // Consistent copy of the latest frame. Spins only while the emulator
+        // is in the middle of an update
+        void read(SharedFrame& aFrame) const;
+
+        void inject(uint16_t aKeys);
+        // Hand the keys back to the emulator
+        void release();
+        void quit();
+
+    private:
+        SharedState* shared{};
+};
+} // chip8 namespace
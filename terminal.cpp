@@ -0,0 +1,193 @@
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "terminal.hpp"
+
+namespace chip8 {
+// Character for each CHIP-8 key, indexed by key
+static char const keyLayout[MAX_KEYS + 1] = "x123qweasdzc4rfv";
+
+// Glyph index 0-3 = bottom pixel << 1 | top pixel
+static char const* const halfBlocks[] = { " ", "▀", "▄", "█" };
+
+Terminal::Terminal(TerminalMode aMode)
+    : mode(aMode)
+    , columns(aMode == TERMINAL_BRAILLE ? GFX_WIDTH / 2 : GFX_WIDTH)
+    , rows(aMode == TERMINAL_BRAILLE ? GFX_HEIGHT / 4 : GFX_HEIGHT / 2)
+    , shown(columns * rows, 0xFFFF) {
+    if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved) == 0) {
+        termios settings = saved;
+        cfmakeraw(&settings);
+        // Keep \n translation for anything printed while we run
+        settings.c_oflag |= OPOST;
+        // Non-blocking reads
+        settings.c_cc[VMIN] = 0;
+        settings.c_cc[VTIME] = 0;
+        raw = tcsetattr(STDIN_FILENO, TCSANOW, &settings) == 0;
+    }
+
+    // Alternate screen, hide the cursor, clear, home
+    flush("\x1b[?1049h\x1b[?25l\x1b[2J\x1b[H");
+}
+
+Terminal::~Terminal() {
+    // Leave the cursor below the picture on the normal screen
+    flush("\x1b[0m\x1b[?25h\x1b[?1049l");
+
+    if (raw) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+    }
+}
+
+void Terminal::update(uint8_t const* buffer) {
+    out.clear();
+
+    for (unsigned int row = 0; row < rows; ++row) {
+        for (unsigned int column = 0; column < columns; ++column) {
+            uint16_t glyph = 0;
+
+            if (mode == TERMINAL_BRAILLE) {
+                // Dot numbering of the braille cell, by (x, y)
+                static uint8_t const dots[4][2] = {
+                    { 0x01, 0x08 }, { 0x02, 0x10 }, { 0x04, 0x20 }, { 0x40, 0x80 }
+                };
+
+                for (unsigned int y = 0; y < 4; ++y) {
+                    uint8_t const* line = buffer + (row * 4 + y) * GFX_WIDTH + column * 2;
+                    glyph |= (line[0] ? dots[y][0] : 0) | (line[1] ? dots[y][1] : 0);
+                }
+            } else {
+                uint8_t const* top = buffer + row * 2 * GFX_WIDTH + column;
+                glyph = (top[0] ? 1 : 0) | (top[GFX_WIDTH] ? 2 : 0);
+            }
+
+            uint16_t& cell = shown[row * columns + column];
+
+            if (cell == glyph) {
+                continue;
+            }
+
+            cell = glyph;
+            moveTo(out, row, column);
+            appendCell(out, glyph);
+            ++cursorColumn;
+        }
+    }
+
+    if (!out.empty()) {
+        flush(out);
+    }
+
+    ++frames;
+}
+
+void Terminal::appendCell(std::string& aOut, unsigned int aGlyph) const {
+    if (mode == TERMINAL_BRAILLE) {
+        // U+2800 + dots, as UTF-8
+        aOut += char(0xE2);
+        aOut += char(0xA0 | (aGlyph >> 6));
+        aOut += char(0x80 | (aGlyph & 0x3F));
+    } else {
+        aOut += halfBlocks[aGlyph];
+    }
+}
+
+void Terminal::moveTo(std::string& aOut, unsigned int aRow, unsigned int aColumn) {
+    if (aRow == cursorRow && aColumn == cursorColumn) {
+        return;
+    }
+
+    char sequence[16];
+
+    if (aRow == cursorRow && aColumn > cursorColumn) {
+        unsigned int gap = aColumn - cursorColumn;
+        int length = snprintf(sequence, sizeof(sequence), "\x1b[%uC", gap);
+
+        // Repainting a short gap is cheaper than skipping it. Every glyph
+        // except the half block blank is 3 bytes of UTF-8
+        size_t repaint = 0;
+
+        for (unsigned int c = cursorColumn; c < aColumn; ++c) {
+            repaint += (mode == TERMINAL_HALF_BLOCK && !shown[aRow * columns + c]) ? 1 : 3;
+        }
+
+        if (repaint <= size_t(length)) {
+            for (unsigned int c = cursorColumn; c < aColumn; ++c) {
+                appendCell(aOut, shown[aRow * columns + c]);
+            }
+
+            cursorColumn = aColumn;
+            return;
+        }
+
+        aOut += sequence;
+    } else {
+        snprintf(sequence, sizeof(sequence), "\x1b[%u;%uH", aRow + 1, aColumn + 1);
+        aOut += sequence;
+    }
+
+    cursorRow = aRow;
+    cursorColumn = aColumn;
+}
+
+void Terminal::flush(std::string const& aOut) {
+    size_t done = 0;
+
+    while (done < aOut.size()) {
+        ssize_t written = write(STDOUT_FILENO, aOut.data() + done, aOut.size() - done);
+
+        if (written <= 0) {
+            break;
+        }
+
+        done += written;
+    }
+
+    bytes += done;
+}
+
+bool Terminal::input(uint8_t* keys) {
+    for (int i = 0; i < MAX_KEYS; ++i) {
+        if (held[i]) {
+            --held[i];
+        }
+    }
+
+    bool quit = false;
+    char pending[64];
+    ssize_t count;
+
+    while ((count = read(STDIN_FILENO, pending, sizeof(pending))) > 0) {
+        for (ssize_t i = 0; i < count; ++i) {
+            char c = pending[i];
+
+            if (c == 0x03) {
+                quit = true;
+            } else if (c == 0x1b) {
+                // A lone Escape quits; escape sequences (arrows etc.) are skipped
+                if (i + 1 == count) {
+                    quit = true;
+                }
+
+                while (i + 1 < count && !((pending[i + 1] >= 'A' && pending[i + 1] <= 'Z') ||
+                                          (pending[i + 1] >= 'a' && pending[i + 1] <= 'z') ||
+                                          pending[i + 1] == '~')) {
+                    ++i;
+                }
+
+                ++i;
+            } else if (char const* k = c ? strchr(keyLayout, c | 0x20) : nullptr) {
+                held[k - keyLayout] = TERMINAL_KEY_HOLD;
+            }
+        }
+    }
+
+    for (int i = 0; i < MAX_KEYS; ++i) {
+        keys[i] = held[i] != 0;
+    }
+
+    return quit;
+}
+} // chip8 namespace
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <termios.h>
+
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "frontend.hpp"
+
+namespace chip8 {
+// Terminals report key presses but not releases; a key counts as held for
+// this many frames after its last press (or auto-repeat)
+#define TERMINAL_KEY_HOLD 6
+
+enum TerminalMode {
+    // U+2580 style half blocks, 64x16 cells
+    TERMINAL_HALF_BLOCK,
+    // U+2800 braille patterns, 32x8 cells
+    TERMINAL_BRAILLE
+};
+
+// Frontend for a text terminal, e.g. over SSH. The screen is mapped onto
+// character cells and only cells that differ from what the terminal already
+// shows are sent, with the shortest cursor movement between them. Keys are
+// read from stdin in raw mode; Escape or Ctrl-C quits.
+//
+// Key layout is the same as Gfx:  1 2 3 4 / q w e r / a s d f / z x c v
+class Terminal final : public Frontend {
+    public:
+        Terminal(TerminalMode aMode = TERMINAL_HALF_BLOCK);
+        ~Terminal();
+
+        void update(uint8_t const* buffer) override;
+        bool input(uint8_t* keys) override;
+
+        // Output sent so far, for judging link usage
+        uint64_t bytesWritten() const { return bytes; }
+        uint64_t framesDrawn() const { return frames; }
+
+    private:
+        void appendCell(std::string& aOut, unsigned int aCell) const;
+        void moveTo(std::string& aOut, unsigned int aRow, unsigned int aColumn);
+        void flush(std::string const& aOut);
+
+        TerminalMode mode;
+        unsigned int columns;
+        unsigned int rows;
+
+        // Glyph index per cell as last sent; 0xFFFF = unknown
+        std::vector<uint16_t> shown;
+        unsigned int cursorRow{};
+        unsigned int cursorColumn{};
+
+        // Frames left until each key is released
+        uint8_t held[MAX_KEYS]{};
+
+        bool raw{};
+        termios saved{};
+
+        std::string out;
+        uint64_t bytes{};
+        uint64_t frames{};
+};
+} // chip8 namespace
@@ -0,0 +1,71 @@
+// A trapping instruction must leave the machine as it found it: no memory
+// written, no registers loaded, nothing drawn. Built and run by compile.sh
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+
+#include "chip8.hpp"
+
+static int failures;
+
+#define CHECK(aCondition)                                                   \
+    do {                                                                    \
+        if (!(aCondition)) {                                                \
+            printf("  %s:%d: %s\n", __FILE__, __LINE__, #aCondition);       \
+            ++failures;                                                     \
+        }                                                                   \
+    } while (0)
+
+// Run every op but the last, then the last one, which must raise a memory trap
+static void expectTrap(char const* aName, std::initializer_list<uint16_t> aOps) {
+    std::string path = std::string("/tmp/chip8-trap-") + aName + ".ch8";
+    std::ofstream rom(path, std::ios::binary);
+
+    for (uint16_t op : aOps) {
+        rom.put(op >> 8);
+        rom.put(op & 0xFF);
+    }
+
+    rom.close();
+
+    printf("%s\n", aName);
+
+    chip8::Chip8 machine(path);
+    machine.run(aOps.size() - 1);
+
+    chip8::Chip8::Snapshot before;
+    machine.save(before);
+    machine.run(1);
+
+    chip8::State const& after = machine.state();
+
+    CHECK(after.fault.kind == chip8::TRAP_MEMORY_BOUNDS);
+    CHECK(after.fault.pc == MEM_LO + 2 * (aOps.size() - 1));
+    CHECK(memcmp(after.memory, before.memory, sizeof(before.memory)) == 0);
+    CHECK(memcmp(after.gfx, before.gfx, sizeof(before.gfx)) == 0);
+    CHECK(memcmp(after.rows, before.rows, sizeof(before.rows)) == 0);
+    CHECK(memcmp(after.V, before.V, sizeof(before.V)) == 0);
+    CHECK(after.I == before.I);
+    CHECK(after.sp == before.sp);
+    CHECK(after.drawCount == before.drawCount);
+
+    remove(path.c_str());
+}
+
+int main() {
+    // I = 0xFFE, V0-V3 = 0xAA, LD [I], V3
+    expectTrap("fx55", {0xAFFE, 0x60AA, 0x61AA, 0x62AA, 0x63AA, 0xF355});
+    // I = 0xFFF, V0 = 255, LD B, V0
+    expectTrap("fx33", {0xAFFF, 0x60FF, 0xF033});
+    // I = 0xFFE, V0-V3 set, LD V3, [I]
+    expectTrap("fx65", {0xAFFE, 0x6011, 0x6122, 0x6233, 0x6344, 0xF365});
+    // I = 0xFF8, VF = 7, 15 row sprite
+    expectTrap("dxyn", {0xAFF8, 0x6F07, 0xD00F});
+    // V0 = 0xFF, JP V0, 0xFFF
+    expectTrap("bnnn", {0x60FF, 0xBFFF});
+
+    printf(failures ? "%d checks failed\n" : "all traps clean\n", failures);
+    return failures ? 1 : 0;
+}